@@ -1,102 +1,2020 @@
+#ifdef _WIN32
 #include <Windows.h>
 #include <GL/glew.h>
+#include <direct.h>
+#else
+//Mesa's libGL exports everything up to its GL version, so there's no need for an extension loader
+#define GL_GLEXT_PROTOTYPES
+#endif
 #include <GL/gl.h>
+#ifndef _WIN32
+#include <GL/glext.h>
+#include <EGL/egl.h>
+#include <EGL/eglext.h>
+#include <time.h>
+#include <sys/stat.h>
+#include <GL/glx.h>
+#endif
 #include <GL/glut.h>
 #include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
 #include <assert.h>
 #include <math.h>
+#include <pthread.h>
+#include <stdatomic.h>
 #include "opengl_math.h"
+#include "opengl_scene.h"
+#include "opengl_mesh.h"
 
 #define WINDOW_WIDTH 800
 #define WINDOW_HEIGHT 800
 
 void render(void);
 
+/*Shader programs
+ *Linked programs are kept on disk, as glGetProgramBinary gives them, so later runs skip compiling and linking - which is what
+ *startup time grows with as shader variants are added. Each is stored under a hash of its sources and of the driver's identity,
+ *so editing a shader or updating the driver just misses the cache. A binary the driver still rejects is reported and replaced
+ *by compiling from source, which is also what happens when the driver doesn't support program binaries at all*/
+#define PROGRAM_CACHE_MAGIC 0x4E494250u		//"PBIN", little-endian
+
+typedef struct {
+	uint32_t magic;
+	uint32_t format;		//from glGetProgramBinary
+	uint64_t key;			//programCacheKey
+	uint32_t length;		//of the binary that follows
+	uint32_t reserved;
+} program_cache_header;
+
+//Set by main to defaultShaderCacheDirectory(), unless --shader-cache=DIRECTORY is given, or to NULL with --no-shader-cache
+char const *shader_cache_directory = NULL;
+
+//The folder inside the user's cache folder that the cache is kept in by default
+#define SHADER_CACHE_NAME "opengl_on_windows"
+
+char default_shader_cache[1024];
+
+//%LOCALAPPDATA% on Windows, and $XDG_CACHE_HOME or ~/.cache elsewhere - only when none of them is set, shader_cache in the
+//working directory
+char const *defaultShaderCacheDirectory(void) {
+	int length = -1;
+
+#ifdef _WIN32
+	char const *base = getenv("LOCALAPPDATA");
+	if(base != NULL && *base != '\0') {
+		length = snprintf(default_shader_cache, sizeof(default_shader_cache), "%s\\" SHADER_CACHE_NAME, base);
+	}
+#else
+	char const *base = getenv("XDG_CACHE_HOME");
+	char const *home = getenv("HOME");
+
+	if(base != NULL && *base != '\0') {
+		length = snprintf(default_shader_cache, sizeof(default_shader_cache), "%s/" SHADER_CACHE_NAME, base);
+	} else if(home != NULL && *home != '\0') {
+		length = snprintf(default_shader_cache, sizeof(default_shader_cache), "%s/.cache/" SHADER_CACHE_NAME, home);
+	}
+#endif
+
+	if(length < 0 || (size_t) length >= sizeof(default_shader_cache)) {
+		return "shader_cache";
+	}
+
+	return default_shader_cache;
+}
+
+//Creates path along with any folders leading to it that are missing - failing harmlessly on those that are already there
+void makeDirectories(char const *path) {
+	char partial[1024];
+	size_t const length = strlen(path);
+
+	if(length >= sizeof(partial)) {
+		return;
+	}
+
+	size_t i;
+	for(i = 1; i <= length; ++i) {
+		if(i == length || path[i] == '/' || path[i] == '\\') {
+			memcpy(partial, path, i);
+			partial[i] = '\0';
+
+#ifdef _WIN32
+			_mkdir(partial);
+#else
+			mkdir(partial, 0777);
+#endif
+		}
+	}
+}
+
+//Whether the last program loadProgram returned came from the cache
+int program_from_cache = 0;
+
+//FNV-1a, including the terminator so consecutive strings can't run into each other
+uint64_t hashString(uint64_t hash, char const *s) {
+	do {
+		hash ^= (unsigned char) *s;
+		hash *= 0x100000001B3ull;
+	} while(*s++ != '\0');
+
+	return hash;
+}
+
+uint64_t programCacheKey(char const *vertex_source, char const *fragment_source) {
+	uint64_t key = 0xCBF29CE484222325ull;
+
+	key = hashString(key, vertex_source);
+	key = hashString(key, fragment_source);
+	key = hashString(key, (char const *) glGetString(GL_VENDOR));
+	key = hashString(key, (char const *) glGetString(GL_RENDERER));
+	key = hashString(key, (char const *) glGetString(GL_VERSION));
+
+	return key;
+}
+
+int programBinariesSupported(void) {
+#ifdef _WIN32
+	//Only there with GL 4.1 or ARB_get_program_binary, and GLEW leaves the pointers NULL otherwise
+	if(glGetProgramBinary == NULL || glProgramBinary == NULL || glProgramParameteri == NULL) {
+		return 0;
+	}
+#endif
+
+	GLint formats = 0;
+	glGetIntegerv(GL_NUM_PROGRAM_BINARY_FORMATS, &formats);
+
+	return formats > 0;
+}
+
+//Compile or link log of object, when there is one, to stderr
+void printInfoLog(GLuint object, int is_program, char const *what) {
+	GLint length = 0;
+	if(is_program) {
+		glGetProgramiv(object, GL_INFO_LOG_LENGTH, &length);
+	} else {
+		glGetShaderiv(object, GL_INFO_LOG_LENGTH, &length);
+	}
+
+	if(length <= 1) {
+		return;
+	}
+
+	char *log = malloc(length);
+	if(is_program) {
+		glGetProgramInfoLog(object, length, NULL, log);
+	} else {
+		glGetShaderInfoLog(object, length, NULL, log);
+	}
+
+	fprintf(stderr, "%s:\n%s\n", what, log);
+	free(log);
+}
+
+//Returns 0 on failure, having printed why
+GLuint compileShader(GLenum type, char const *source) {
+	char const *what = (type == GL_VERTEX_SHADER ? "Vertex shader" : "Fragment shader");
+
+	GLuint shader = glCreateShader(type);
+	glShaderSource(shader, 1, &source, NULL);
+	glCompileShader(shader);
+
+	GLint compiled = GL_FALSE;
+	glGetShaderiv(shader, GL_COMPILE_STATUS, &compiled);
+
+	if(!compiled) {
+		fprintf(stderr, "%s failed to compile\n", what);
+		printInfoLog(shader, 0, what);
+		glDeleteShader(shader);
+
+		return 0;
+	}
+
+	return shader;
+}
+
+//Links program from source into program, returning 0 on failure, having printed why
+int buildProgram(GLuint program, char const *vertex_source, char const *fragment_source, int retrievable) {
+	GLuint vertex_shader = compileShader(GL_VERTEX_SHADER, vertex_source);
+	GLuint fragment_shader = compileShader(GL_FRAGMENT_SHADER, fragment_source);
+
+	if(vertex_shader == 0 || fragment_shader == 0) {
+		glDeleteShader(vertex_shader);
+		glDeleteShader(fragment_shader);
+
+		return 0;
+	}
+
+	glAttachShader(program, vertex_shader);
+	glAttachShader(program, fragment_shader);
+
+	if(retrievable) {
+		glProgramParameteri(program, GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE);
+	}
+
+	glLinkProgram(program);
+
+	//The program keeps what it needs, so the shaders can go as soon as it's linked
+	glDetachShader(program, vertex_shader);
+	glDetachShader(program, fragment_shader);
+	glDeleteShader(vertex_shader);
+	glDeleteShader(fragment_shader);
+
+	GLint linked = GL_FALSE;
+	glGetProgramiv(program, GL_LINK_STATUS, &linked);
+
+	if(!linked) {
+		fprintf(stderr, "Shader program failed to link\n");
+		printInfoLog(program, 1, "Link log");
+
+		return 0;
+	}
+
+	return 1;
+}
+
+void programCachePath(char *path, size_t size, uint64_t key) {
+	snprintf(path, size, "%s/%016llx.bin", shader_cache_directory, (unsigned long long) key);
+}
+
+//Returns 0 if there's no usable binary for key in the cache, leaving program unlinked
+int loadCachedProgram(GLuint program, uint64_t key) {
+	char path[1024];
+	programCachePath(path, sizeof(path), key);
+
+	FILE *file = fopen(path, "rb");
+	if(file == NULL) {
+		return 0;
+	}
+
+	program_cache_header header;
+	void *binary = NULL;
+
+	int read = (fread(&header, sizeof(header), 1, file) == 1 && header.magic == PROGRAM_CACHE_MAGIC && header.key == key
+				&& header.length > 0 && (binary = malloc(header.length)) != NULL && fread(binary, 1, header.length, file) == header.length);
+	fclose(file);
+
+	GLint linked = GL_FALSE;
+	if(read) {
+		glProgramBinary(program, header.format, binary, header.length);
+		glGetProgramiv(program, GL_LINK_STATUS, &linked);
+	}
+
+	free(binary);
+
+	if(!linked) {
+		fprintf(stderr, "Ignoring cached shader program %s (%s), compiling it instead\n", path, read ? "rejected by the driver" : "unreadable");
+	}
+
+	return linked;
+}
+
+void saveCachedProgram(GLuint program, uint64_t key) {
+	GLint length = 0;
+	glGetProgramiv(program, GL_PROGRAM_BINARY_LENGTH, &length);
+
+	if(length <= 0) {
+		return;
+	}
+
+	program_cache_header header = {PROGRAM_CACHE_MAGIC, 0, key, (uint32_t) length, 0};
+	void *binary = malloc(length);
+
+	GLenum format;
+	glGetProgramBinary(program, length, NULL, &format, binary);
+	header.format = format;
+
+	makeDirectories(shader_cache_directory);
+
+	char path[1024];
+	programCachePath(path, sizeof(path), key);
+
+	FILE *file = fopen(path, "wb");
+	int written = (file != NULL && fwrite(&header, sizeof(header), 1, file) == 1 && fwrite(binary, 1, length, file) == (size_t) length);
+
+	if(file != NULL && fclose(file) != 0) {
+		written = 0;
+	}
+
+	if(!written) {
+		fprintf(stderr, "Couldn't write the shader cache file %s\n", path);
+
+		//A partial file would only be rejected later anyway
+		remove(path);
+	}
+
+	free(binary);
+}
+
+//Returns 0 if the program can't be built, having printed why
+GLuint loadProgram(char const *vertex_source, char const *fragment_source) {
+	GLuint program = glCreateProgram();
+
+	int cached = (shader_cache_directory != NULL && programBinariesSupported());
+	uint64_t key = (cached ? programCacheKey(vertex_source, fragment_source) : 0);
+
+	program_from_cache = (cached && loadCachedProgram(program, key));
+	if(program_from_cache) {
+		return program;
+	}
+
+	//A rejected binary may have left the program in an odd state, so building starts from a fresh one
+	glDeleteProgram(program);
+	program = glCreateProgram();
+
+	if(!buildProgram(program, vertex_source, fragment_source, cached)) {
+		glDeleteProgram(program);
+
+		return 0;
+	}
+
+	if(cached) {
+		saveCachedProgram(program, key);
+	}
+
+	return program;
+}
+
 GLuint initShaders() {
-	//Creating the vertex shader
-	GLuint vertex_shader = glCreateShader(GL_VERTEX_SHADER);
+	//Note that these string literals will be automatically concatenated into a single one
+	//mModel is per instance (one per grid cell); mLocal is applied before it, to draw the outlines slightly larger than the faces
+	//The Camera block is filled from a uniform buffer (see uploadCamera), with mViewProjection = mProjection * mView
+	char const * const vtx_shd = "#version 330\n"
+								 "layout(std140) uniform Camera {"
+									"mat4 mView;"
+									"mat4 mProjection;"
+									"mat4 mViewProjection;"
+								 "};"
+								 "uniform mat4 mLocal;"
+								 "in vec3 vPosition;"
+								 "in mat4 mModel;"
+								 "void main() {"
+									"gl_Position = mViewProjection * mModel * mLocal * vec4(vPosition, 1.0);"
+								 "}";
+
+	char const * const frg_shd = "#version 330\n"
+								 "uniform bool mode;"
+								 "out vec4 fragColor;"
+								 "void main() {"
+									 "if(mode) {"
+										"fragColor = vec4(0.62745098039, 0.55686274509, 0.09411764705, 1.0);"
+									 "} else {"
+										"fragColor = vec4(0.3725490196, 0.0, 0.90588235294, 1.0);"
+									 "}"
+								 "}";
+
+	return loadProgram(vtx_shd, frg_shd);
+}
+
+GLint mLocalLoc;
+GLint modeLoc;
+
+GLuint surface_vertex_buffer;
+GLuint surface_element_buffer;
+GLuint instance_buffer;
+
+GLuint program;
+GLuint scene_vertex_array;
+
+float const cube_vertices[3 * 8] = {-0.5, 0.5, 0.5, 0.5, 0.5, 0.5, 0.5, -0.5, 0.5, -0.5, -0.5, 0.5,
+									-0.5, 0.5, -0.5, 0.5, 0.5, -0.5, 0.5, -0.5, -0.5, -0.5, -0.5, -0.5};
+
+//Two fans that cover the cube between them, each also drawn as a loop for the outline
+unsigned char const cube_indices[16] = {0, 1, 2, 3, 7, 4, 5, 1,
+										6, 2, 3, 7, 4, 5, 1, 2};
+
+mesh_part const cube_parts[4] = {{MESH_TRIANGLE_FAN, 0, 8, 0}, {MESH_TRIANGLE_FAN, 8, 8, 0},
+								 {MESH_LINE_LOOP, 0, 8, 0}, {MESH_LINE_LOOP, 8, 8, 0}};
+
+mesh cube_mesh = {.vertex_count = 8, .stream_count = 1, .streams = {{MESH_POSITION, 3, cube_vertices}},
+				  .index_count = 16, .index_size = 1, .indices = cube_indices, .part_count = 4, .parts = cube_parts,
+				  .bounds_min = {-0.5f, -0.5f, -0.5f}, .bounds_max = {0.5f, 0.5f, 0.5f}};
+
+/*What every grid cell draws - the cube above, or whatever --mesh loaded
+ *initScene uploads it (the cube as an optimised copy) and keeps only the parts and bounds, after which anything but the cube is closed*/
+mesh *surface_mesh = &cube_mesh;
+
+mesh_part *surface_parts = NULL;
+size_t surface_part_count = 0;
+GLenum surface_index_type;
+size_t surface_index_size;
+
+//Returns the position stream of m, or NULL if it hasn't got one
+mesh_stream const *meshPositions(mesh const *m) {
+	size_t i;
+	for(i = 0; i < m->stream_count; ++i) {
+		if(m->streams[i].attribute == MESH_POSITION) {
+			return m->streams + i;
+		}
+	}
+
+	return NULL;
+}
+
+/*Frame statistics
+ *CPU time is split by phase as the frame goes; GPU time comes from a ring of timer queries, each read a few frames after it was
+ *issued so waiting for it never stalls the pipeline. Draw calls and state changes are counted by the wrappers below, which
+ *every GL call in the frame's hot path goes through. With the frame pipeline, math is the time spent building the next frame's
+ *packet or, when a worker thread builds it, waiting for this one's*/
+typedef enum {PHASE_MATH, PHASE_UPLOAD, PHASE_DRAW, PHASE_OVERLAY, PHASE_SWAP, PHASE_COUNT} frame_phase;
+
+char const * const phase_names[PHASE_COUNT] = {"math", "upload", "draw", "overlay", "swap"};
+
+typedef struct {
+	double phase_time[PHASE_COUNT];	//seconds
+	double gpu_time;				//seconds, for the most recent frame whose query has come back (negative until one has)
+	unsigned int draw_calls;
+	unsigned int cells_drawn;				//grid cells that survived culling
+	unsigned int state_changes;
+	unsigned int filtered_state_changes;	//redundant ones the shadowing wrappers didn't pass on to GL
+	size_t allocations;				//heap allocations made by opengl_math
+	double prepare_time;			//seconds, spent building the frame_packet this frame drew, on whichever thread built it
+} frame_stats;
+
+#define GPU_QUERY_COUNT 4
+
+frame_stats current_stats;
+frame_stats last_stats;		//the last complete frame, which is what the overlay shows
+unsigned long frame_number = 0;
+double phase_start;
+size_t frame_allocations_start;
+GLuint gpu_queries[GPU_QUERY_COUNT];
+FILE *stats_csv = NULL;		//set with --stats-csv=path
+
+double nowSeconds(void) {
+#ifdef _WIN32
+	LARGE_INTEGER frequency, counter;
+	QueryPerformanceFrequency(&frequency);
+	QueryPerformanceCounter(&counter);
+
+	return (double) counter.QuadPart / (double) frequency.QuadPart;
+#else
+	struct timespec t;
+	clock_gettime(CLOCK_MONOTONIC, &t);
+
+	return t.tv_sec + t.tv_nsec * 1e-9;
+#endif
+}
+
+void beginFrameStatistics(void) {
+	double gpu_time = current_stats.gpu_time;
+
+	memset(&current_stats, 0, sizeof(current_stats));
+	current_stats.gpu_time = gpu_time;
+
+	//The query about to be reused was issued GPU_QUERY_COUNT frames ago, so it's normally long done
+	//The very first frame's is skipped, as it also covers the driver warming up
+	GLuint query = gpu_queries[frame_number % GPU_QUERY_COUNT];
+	if(frame_number > GPU_QUERY_COUNT) {
+		GLint available = 0;
+		glGetQueryObjectiv(query, GL_QUERY_RESULT_AVAILABLE, &available);
+
+		if(available) {
+			GLuint64 elapsed;
+			glGetQueryObjectui64v(query, GL_QUERY_RESULT, &elapsed);
+
+			current_stats.gpu_time = elapsed * 1e-9;
+		}
+	}
+
+	glBeginQuery(GL_TIME_ELAPSED, query);
+
+	frame_allocations_start = mathAllocationCount();
+	phase_start = nowSeconds();
+}
+
+//Charges the time since the previous phase ended to phase
+void endPhase(frame_phase phase) {
+	double now = nowSeconds();
+
+	current_stats.phase_time[phase] += now - phase_start;
+	phase_start = now;
+}
+
+//The swap is left out of the GPU query, since it may wait for vsync
+void endFrameCommands(void) {
+	glEndQuery(GL_TIME_ELAPSED);
+}
+
+void endFrameStatistics(void) {
+	current_stats.allocations = mathAllocationCount() - frame_allocations_start;
+	last_stats = current_stats;
+
+	if(stats_csv != NULL) {
+		double cpu_time = 0.0;
+
+		fprintf(stats_csv, "%lu", frame_number);
+
+		size_t phase;
+		for(phase = 0; phase < PHASE_COUNT; ++phase) {
+			fprintf(stats_csv, ",%.4f", last_stats.phase_time[phase] * 1000.0);
+			cpu_time += last_stats.phase_time[phase];
+		}
+
+		fprintf(stats_csv, ",%.4f,", cpu_time * 1000.0);
+		if(last_stats.gpu_time >= 0.0) {
+			fprintf(stats_csv, "%.4f", last_stats.gpu_time * 1000.0);
+		}
+		fprintf(stats_csv, ",%u,%u,%u,%u,%lu,%.4f\n", last_stats.draw_calls, last_stats.cells_drawn, last_stats.state_changes,
+				last_stats.filtered_state_changes, (unsigned long) last_stats.allocations, last_stats.prepare_time * 1000.0);
+	}
+
+	++frame_number;
+}
+
+int openStatisticsCSV(char const *path) {
+	stats_csv = fopen(path, "w");
+
+	if(stats_csv == NULL) {
+		fprintf(stderr, "Could not open %s for writing\n", path);
+
+		return 0;
+	}
+
+	fprintf(stats_csv, "frame");
+
+	size_t phase;
+	for(phase = 0; phase < PHASE_COUNT; ++phase) {
+		fprintf(stats_csv, ",%s_ms", phase_names[phase]);
+	}
+
+	fprintf(stats_csv, ",cpu_ms,gpu_ms,draw_calls,cells_drawn,state_changes,filtered_state_changes,allocations,prepare_ms\n");
+
+	return 1;
+}
+
+/*State shadowing
+ *The binds and uniforms made every frame go through these wrappers, which remember what GL was last given and drop calls that
+ *wouldn't change anything. Uniform values are shadowed for whichever program is current, and forgotten when it changes - the
+ *scene's and the overlay text's only alternate once a frame. Anything set behind their back must be followed by forgetGLState()*/
+#define UNKNOWN_BINDING ((GLuint) -1)
+#define SHADOWED_UNIFORM_COUNT 8
+
+typedef struct {
+	GLint location;
+	int has_int;
+	GLint int_value;
+	int has_matrix;
+	mat4 matrix;
+} shadowed_uniform;
+
+typedef struct {
+	GLuint program;
+	GLuint vertex_array;
+	GLuint array_buffer;
+	GLuint element_array_buffer;	//part of the bound vertex array's state
+	GLuint uniform_buffer;
+
+	shadowed_uniform uniforms[SHADOWED_UNIFORM_COUNT];
+	size_t uniform_count;
+} gl_state;
+
+gl_state shadow;
+
+void forgetGLState(void) {
+	shadow.program = UNKNOWN_BINDING;
+	shadow.vertex_array = UNKNOWN_BINDING;
+	shadow.array_buffer = UNKNOWN_BINDING;
+	shadow.element_array_buffer = UNKNOWN_BINDING;
+	shadow.uniform_buffer = UNKNOWN_BINDING;
+	shadow.uniform_count = 0;
+}
+
+//Returns whether the call is needed, updating *slot and the counters either way
+int shadowBinding(GLuint *slot, GLuint value) {
+	if(*slot == value) {
+		++current_stats.filtered_state_changes;
+
+		return 0;
+	}
+
+	*slot = value;
+	++current_stats.state_changes;
+
+	return 1;
+}
+
+//NULL once the table is full, in which case the uniform just isn't shadowed
+shadowed_uniform *findShadowedUniform(GLint location) {
+	size_t i;
+	for(i = 0; i < shadow.uniform_count; ++i) {
+		if(shadow.uniforms[i].location == location) {
+			return &shadow.uniforms[i];
+		}
+	}
+
+	if(shadow.uniform_count == SHADOWED_UNIFORM_COUNT) {
+		return NULL;
+	}
+
+	shadowed_uniform *uniform = &shadow.uniforms[shadow.uniform_count++];
+	uniform->location = location;
+	uniform->has_int = 0;
+	uniform->has_matrix = 0;
+
+	return uniform;
+}
+
+void stateUseProgram(GLuint program) {
+	if(shadowBinding(&shadow.program, program)) {
+		glUseProgram(program);
+		shadow.uniform_count = 0;
+	}
+}
+
+void stateBindVertexArray(GLuint vertex_array) {
+	if(shadowBinding(&shadow.vertex_array, vertex_array)) {
+		glBindVertexArray(vertex_array);
+		shadow.element_array_buffer = UNKNOWN_BINDING;
+	}
+}
+
+void stateBindBuffer(GLenum target, GLuint buffer) {
+	GLuint *slot = NULL;
+
+	switch(target) {
+		case GL_ARRAY_BUFFER:
+			slot = &shadow.array_buffer;
+			break;
+		case GL_ELEMENT_ARRAY_BUFFER:
+			slot = &shadow.element_array_buffer;
+			break;
+		case GL_UNIFORM_BUFFER:
+			slot = &shadow.uniform_buffer;
+			break;
+	}
+
+	if(slot == NULL) {
+		glBindBuffer(target, buffer);
+		++current_stats.state_changes;
+	} else if(shadowBinding(slot, buffer)) {
+		glBindBuffer(target, buffer);
+	}
+}
+
+void stateUniform1i(GLint location, GLint value) {
+	shadowed_uniform *uniform = findShadowedUniform(location);
+
+	if(uniform != NULL && uniform->has_int && uniform->int_value == value) {
+		++current_stats.filtered_state_changes;
+
+		return;
+	}
+
+	if(uniform != NULL) {
+		uniform->has_int = 1;
+		uniform->int_value = value;
+	}
+
+	glUniform1i(location, value);
+	++current_stats.state_changes;
+}
+
+void stateUniformMatrix4fv(GLint location, mat4 const *m) {
+	shadowed_uniform *uniform = findShadowedUniform(location);
+
+	if(uniform != NULL && uniform->has_matrix && memcmp(uniform->matrix.data, m->data, sizeof(m->data)) == 0) {
+		++current_stats.filtered_state_changes;
+
+		return;
+	}
+
+	if(uniform != NULL) {
+		uniform->has_matrix = 1;
+		uniform->matrix = *m;
+	}
+
+	glUniformMatrix4fv(location, 1, GL_FALSE, m->data);
+	++current_stats.state_changes;
+}
+
+void drawElementsInstanced(GLenum mode, GLsizei count, GLenum type, size_t offset, GLsizei instances) {
+	glDrawElementsInstanced(mode, count, type, (void *) offset, instances);
+	++current_stats.draw_calls;
+}
+
+void drawElements(GLenum mode, GLsizei count, GLenum type, size_t offset) {
+	glDrawElements(mode, count, type, (void *) offset);
+	++current_stats.draw_calls;
+}
+
+/*Camera
+ *View, projection and their product are cached, and only rebuilt when something they depend on changes - keyboard() moving the
+ *eye, or the window being resized. They reach the shaders through a uniform buffer that is only rewritten on frames where they
+ *changed, so a frame with a still camera does no camera math and no camera uploads at all
+ *Input goes to scene_camera, but the matrices are built in the frame pipeline's copy of it, frame_camera*/
+typedef struct {
+	vec3 eye;
+	vec3 at;
+	vec3 up;
+
+	//Orthographic volume (not near/far, which <Windows.h> defines as macros)
+	float left, right, bottom, top, z_near, z_far;
+
+	mat4 view;
+	mat4 projection;
+	mat4 view_projection;
+
+	int view_dirty;
+	int projection_dirty;
+	int upload_dirty;			//the matrices changed since they were last uploaded
+
+	GLuint uniform_buffer;		//laid out like the shaders' std140 Camera block
+} camera;
+
+#define CAMERA_BINDING 0
+
+camera scene_camera;
+
+void initCamera(camera *c) {
+	setVec3(&c->eye, 0.0f, 0.0f, 1.0f);
+	setVec3(&c->at, 0.0f, 0.0f, 0.0f);
+	setVec3(&c->up, 0.0f, 1.0f, 0.0f);
+
+	c->left = -1.0f;
+	c->right = 1.0f;
+	c->bottom = -1.0f;
+	c->top = 1.0f;
+	c->z_near = 0.0f;
+	c->z_far = 2.0f;
+
+	c->view_dirty = 1;
+	c->projection_dirty = 1;
+	c->upload_dirty = 1;
+
+	glGenBuffers(1, &c->uniform_buffer);
+	glBindBuffer(GL_UNIFORM_BUFFER, c->uniform_buffer);
+	glBufferData(GL_UNIFORM_BUFFER, 3 * sizeof(mat4), NULL, GL_DYNAMIC_DRAW);
+	glBindBufferBase(GL_UNIFORM_BUFFER, CAMERA_BINDING, c->uniform_buffer);
+}
+
+void setCameraEye(camera *c, float x, float y, float z) {
+	setVec3(&c->eye, x, y, z);
+	c->view_dirty = 1;
+}
+
+//Keeps the whole -1 to 1 square in view and widens the other axis to the window's aspect ratio, so cells stay square
+void setCameraViewport(camera *c, int width, int height) {
+	float const aspect = (float) width / (height > 0 ? height : 1);
+
+	if(aspect >= 1.0f) {
+		c->left = -aspect;
+		c->right = aspect;
+		c->bottom = -1.0f;
+		c->top = 1.0f;
+	} else {
+		c->left = -1.0f;
+		c->right = 1.0f;
+		c->bottom = -1.0f / aspect;
+		c->top = 1.0f / aspect;
+	}
+
+	c->projection_dirty = 1;
+}
+
+//Rebuilds whatever is out of date; returns whether anything was
+int updateCamera(camera *c) {
+	if(!c->view_dirty && !c->projection_dirty) {
+		return 0;
+	}
+
+	if(c->view_dirty) {
+		lookAtMat4(&c->view, &c->eye, &c->at, &c->up);
+		c->view_dirty = 0;
+	}
+
+	if(c->projection_dirty) {
+		orthoMat4(&c->projection, c->left, c->right, c->bottom, c->top, c->z_near, c->z_far);
+		c->projection_dirty = 0;
+	}
+
+	multMat4(&c->view_projection, &c->projection, &c->view);
+	c->upload_dirty = 1;
+
+	return 1;
+}
+
+void uploadCamera(camera *c) {
+	if(!c->upload_dirty) {
+		return;
+	}
+
+	mat4 block[3];
+	block[0] = c->view;
+	block[1] = c->projection;
+	block[2] = c->view_projection;
+
+	stateBindBuffer(GL_UNIFORM_BUFFER, c->uniform_buffer);
+	glBufferSubData(GL_UNIFORM_BUFFER, 0, sizeof(block), block);
+	++current_stats.state_changes;
+
+	c->upload_dirty = 0;
+}
+
+//Kept by reshape, for placing the overlay text
+int window_width = WINDOW_WIDTH;
+int window_height = WINDOW_HEIGHT;
+
+void reshape(int width, int height) {
+	window_width = width;
+	window_height = height;
+
+	glViewport(0, 0, width, height);
+	setCameraViewport(&scene_camera, width, height);
+}
+
+float horizontal_movement = 0.0;
+float vertical_movement = 0.0;
+float depth_movement = 0.0;
+
+/*Camera paths are text files with one "FRAME KEY" or "FIRST-LAST KEY" line per input, where KEY is one of the names below
+ *Each line presses KEY once on every frame in its range, right before that frame is rendered, exactly as keyboard() would
+ *Blank lines and lines starting with # are ignored*/
+typedef struct {
+	char const *name;
+	int key;
+} camera_key;
+
+camera_key const camera_keys[] = {
+	{"LEFT", GLUT_KEY_LEFT},
+	{"RIGHT", GLUT_KEY_RIGHT},
+	{"UP", GLUT_KEY_UP},
+	{"DOWN", GLUT_KEY_DOWN},
+	{"PAGE_UP", GLUT_KEY_PAGE_UP},
+	{"PAGE_DOWN", GLUT_KEY_PAGE_DOWN},
+};
+
+#define CAMERA_KEY_COUNT (sizeof(camera_keys)/sizeof(camera_keys[0]))
+
+typedef struct {
+	unsigned long first;
+	unsigned long last;
+	int key;
+} camera_event;
+
+//Used when --headless isn't given a --camera-path: pan diagonally, come back along both axes, then pull the camera back
+camera_event const default_camera_path[] = {
+	{0, 29, GLUT_KEY_RIGHT},
+	{0, 29, GLUT_KEY_UP},
+	{30, 59, GLUT_KEY_LEFT},
+	{60, 89, GLUT_KEY_DOWN},
+	{90, 99, GLUT_KEY_PAGE_DOWN},
+};
+
+camera_event *camera_path = NULL;
+size_t camera_path_length = 0;
+
+//Set by --record-camera-path, every key press is appended to it along with the frame it affects
+FILE *camera_recording = NULL;
+
+char const *cameraKeyName(int key) {
+	size_t i;
+	for(i = 0; i < CAMERA_KEY_COUNT; ++i) {
+		if(camera_keys[i].key == key) {
+			return camera_keys[i].name;
+		}
+	}
+
+	return NULL;
+}
+
+int loadCameraPath(char const *path) {
+	FILE *file = fopen(path, "r");
+	if(file == NULL) {
+		fprintf(stderr, "Couldn't open camera path %s\n", path);
+
+		return 0;
+	}
+
+	size_t capacity = 0;
+	unsigned int line_number = 0;
+	char line[256];
+	while(fgets(line, sizeof(line), file) != NULL) {
+		++line_number;
+
+		char *start = line + strspn(line, " \t");
+		if(*start == '#' || *start == '\n' || *start == '\r' || *start == '\0') {
+			continue;
+		}
+
+		camera_event event;
+		char name[32];
+		if(sscanf(start, "%lu-%lu %31s", &event.first, &event.last, name) != 3) {
+			if(sscanf(start, "%lu %31s", &event.first, name) != 2) {
+				fprintf(stderr, "%s:%u: expected \"FRAME KEY\" or \"FIRST-LAST KEY\"\n", path, line_number);
+				fclose(file);
+
+				return 0;
+			}
+
+			event.last = event.first;
+		}
+
+		size_t i;
+		for(i = 0; i < CAMERA_KEY_COUNT && strcmp(camera_keys[i].name, name) != 0; ++i);
+
+		if(i == CAMERA_KEY_COUNT || event.last < event.first) {
+			fprintf(stderr, "%s:%u: bad key or frame range\n", path, line_number);
+			fclose(file);
+
+			return 0;
+		}
+
+		event.key = camera_keys[i].key;
+
+		if(camera_path_length == capacity) {
+			capacity = capacity == 0 ? 64 : capacity * 2;
+			camera_path = realloc(camera_path, capacity * sizeof(camera_event));
+		}
+
+		camera_path[camera_path_length++] = event;
+	}
+
+	fclose(file);
+
+	//Left empty, the default path would silently be played instead
+	if(camera_path_length == 0) {
+		fprintf(stderr, "Camera path %s has no events\n", path);
+
+		return 0;
+	}
+
+	return 1;
+}
+
+void keyboard(int key, int x, int y);
+
+//Presses every key the camera path has for this frame
+void replayCameraPath(unsigned long frame) {
+	camera_event const *events = camera_path != NULL ? camera_path : default_camera_path;
+	size_t count = camera_path != NULL ? camera_path_length : sizeof(default_camera_path)/sizeof(default_camera_path[0]);
+
+	size_t i;
+	for(i = 0; i < count; ++i) {
+		if(events[i].first <= frame && frame <= events[i].last) {
+			keyboard(events[i].key, 0, 0);
+		}
+	}
+}
+
+//Number of frames needed to play the whole camera path
+unsigned long cameraPathFrames(void) {
+	camera_event const *events = camera_path != NULL ? camera_path : default_camera_path;
+	size_t count = camera_path != NULL ? camera_path_length : sizeof(default_camera_path)/sizeof(default_camera_path[0]);
+
+	unsigned long frames = 0;
+	size_t i;
+	for(i = 0; i < count; ++i) {
+		if(events[i].last + 1 > frames) {
+			frames = events[i].last + 1;
+		}
+	}
+
+	return frames;
+}
+
+void keyboard(int key, int x, int y) {
+	if(camera_recording != NULL && cameraKeyName(key) != NULL) {
+		//The packet for frame frame_number has already been asked for, so keys pressed now only show up in the one after it
+		fprintf(camera_recording, "%lu %s\n", frame_number + 1, cameraKeyName(key));
+		//glutMainLoop never returns, so this is the only chance to get it onto disk
+		fflush(camera_recording);
+	}
+
+	switch(key) {
+		case GLUT_KEY_LEFT:
+			horizontal_movement -= 0.01f;
+			break;
+		case GLUT_KEY_RIGHT:
+			horizontal_movement += 0.01f;
+			break;
+		case GLUT_KEY_UP:
+			vertical_movement += 0.01f;
+			break;
+		case GLUT_KEY_DOWN:
+			vertical_movement -= 0.01f;
+			break;
+		case GLUT_KEY_PAGE_UP:
+			depth_movement -= 0.01f;
+			break;
+		case GLUT_KEY_PAGE_DOWN:
+			depth_movement += 0.01f;
+			break;
+		default:
+			return;
+	}
+
+	setCameraEye(&scene_camera, horizontal_movement, vertical_movement, 1.0f + depth_movement);
+}
+
+/*Main loop (windowed mode)
+ *Keys are tracked from being pressed to being released, and the camera moves in fixed SIMULATION_RATE steps - as many as the
+ *time since the last one calls for, each pressing every held key once - so its speed depends neither on the frame rate nor on
+ *the keyboard's repeat rate. idle sleeps until the next step is due, never longer, so key releases and window events are seen
+ *within a step however low --fps is. Frames are only drawn when something changed - so at most once a step, and at most --fps
+ *times a second, with a change that comes too soon held in scene_changed until a frame may be drawn. Since a frame draws the
+ *packet the previous one asked for, the frame after the last change is drawn too (see frame_pending). Otherwise, idle isn't
+ *registered at all, so GLUT waits for the next event instead of spinning a core*/
+#define SIMULATION_RATE 60
+#define SIMULATION_STEP (1.0 / SIMULATION_RATE)
+#define MAX_SIMULATION_STEPS 8		//after a stall, catch up at most this far rather than taking longer and longer to
+
+int keys_held[CAMERA_KEY_COUNT];
+size_t held_key_count = 0;
+
+double simulation_time;			//how far the simulation has got
+double next_frame_time = 0.0;
+
+//Set when the packet asked for last will look different from the one just drawn, so it needs a frame of its own
+int frame_pending = 0;
+
+//Set when the camera moved since the last frame was posted
+int scene_changed = 0;
+
+//Set with --fps=N, 0 meaning as fast as possible; --vsync also waits for the display's refresh
+unsigned int target_fps = 60;
+int vsync = 0;
+
+void idle(void);
+
+void sleepSeconds(double seconds) {
+#ifdef _WIN32
+	Sleep((DWORD) (seconds * 1000.0));
+#else
+	struct timespec t;
+	t.tv_sec = (time_t) seconds;
+	t.tv_nsec = (long) ((seconds - (double) t.tv_sec) * 1e9);
+
+	nanosleep(&t, NULL);
+#endif
+}
+
+//Returns 0 if the driver can't
+int setSwapInterval(int interval) {
+#ifdef _WIN32
+	typedef BOOL (WINAPI *swap_interval_function)(int);
+	swap_interval_function swapInterval = (swap_interval_function) wglGetProcAddress("wglSwapIntervalEXT");
+#else
+	typedef int (*swap_interval_function)(int);
+	swap_interval_function swapInterval = (swap_interval_function) glXGetProcAddressARB((GLubyte const *) "glXSwapIntervalSGI");
+#endif
+
+	return swapInterval != NULL && swapInterval(interval);
+}
+
+int cameraKeyIndex(int key) {
+	size_t i;
+	for(i = 0; i < CAMERA_KEY_COUNT; ++i) {
+		if(camera_keys[i].key == key) {
+			return (int) i;
+		}
+	}
+
+	return -1;
+}
+
+void keyDown(int key, int x, int y) {
+	int const index = cameraKeyIndex(key);
+	if(index < 0 || keys_held[index]) {
+		return;
+	}
+
+	//A tap moves as far as one step, however short it is
+	keyboard(key, x, y);
+	glutPostRedisplay();
+
+	keys_held[index] = 1;
+
+	//Nothing was moving, so the time since the last step mustn't be made up for
+	if(held_key_count++ == 0) {
+		simulation_time = nowSeconds();
+		glutIdleFunc(idle);
+	}
+}
+
+void keyUp(int key, int x, int y) {
+	(void) x;
+	(void) y;
+
+	int const index = cameraKeyIndex(key);
+	if(index < 0 || !keys_held[index]) {
+		return;
+	}
+
+	keys_held[index] = 0;
+	--held_key_count;
+}
+
+void idle(void) {
+	//Nothing can change before the next step
+	double const wake_time = simulation_time + SIMULATION_STEP;
+
+	double now = nowSeconds();
+	if(now < wake_time) {
+		sleepSeconds(wake_time - now);
+		now = nowSeconds();
+	}
+
+	unsigned int steps;
+	for(steps = 0; simulation_time + SIMULATION_STEP <= now && steps < MAX_SIMULATION_STEPS; ++steps) {
+		size_t i;
+		for(i = 0; i < CAMERA_KEY_COUNT; ++i) {
+			if(keys_held[i]) {
+				keyboard(camera_keys[i].key, 0, 0);
+				scene_changed = 1;
+			}
+		}
+
+		simulation_time += SIMULATION_STEP;
+	}
+
+	//Only a stall leaves steps undone, since idle wakes up for every one otherwise
+	if(simulation_time + SIMULATION_STEP <= now) {
+		simulation_time = now;
+	}
+
+	if((scene_changed || frame_pending) && (target_fps == 0 || now >= next_frame_time)) {
+		glutPostRedisplay();
+		scene_changed = 0;
+
+		//Whole periods from the last deadline keep the pace even, unless this frame is so late that would mean catching up
+		if(target_fps > 0) {
+			double const period = 1.0 / target_fps;
+			next_frame_time = (next_frame_time + period > now ? next_frame_time + period : now + period);
+		}
+	}
+
+	if(held_key_count == 0 && !frame_pending && !scene_changed) {
+		glutIdleFunc(NULL);
+	}
+}
+
+const float surfaceUnitLength = 0.125f;
+
+//mLocal for the faces and for the outlines, which are drawn slightly larger so they aren't hidden by the faces
+#define OUTLINE_SCALE 1.01f
+mat4 surface_local;
+mat4 outline_local;
+
+//Grid size, set with --grid=WIDTHxLENGTH
+unsigned int surface_width = 3;
+unsigned int surface_length = 3;
+
+/*One scene node per grid cell, all children of a root node for the whole surface (cell i is node i + 1)
+ *Nothing moves at the moment, so after the first frame updateSceneGraph has nothing to do*/
+scene_graph *surface_scene = NULL;
+size_t surface_root;
+
+/*Frustum culling
+ *Every cell has a world-space bounding box, kept as separate arrays of centres and half-extents so they can be tested in SIMD
+ *batches. Whenever the camera or the scene moves, the cells are culled again and the model matrices of the visible ones are
+ *packed into instance_buffer, so only those are drawn. Disabled with --no-culling, in which case every cell is drawn*/
+int culling = 1;
+
+float *cell_center[3];
+float *cell_extent[3];
+
+unsigned int *visible_cells = NULL;
+GLsizei visible_cell_count = 0;
+
+//Box around the mesh as drawn, faces and outlines both, in its own space
+float local_center[3];
+float local_extent[3];
+
+void setLocalBounds(float const *bounds_min, float const *bounds_max) {
+	size_t axis;
+	for(axis = 0; axis < 3; ++axis) {
+		//The outlines are the mesh scaled by OUTLINE_SCALE about the origin, so the box has to cover both
+		float low = fminf(bounds_min[axis], bounds_min[axis] * OUTLINE_SCALE);
+		float high = fmaxf(bounds_max[axis], bounds_max[axis] * OUTLINE_SCALE);
+
+		local_center[axis] = (low + high) * 0.5f;
+		local_extent[axis] = (high - low) * 0.5f;
+	}
+}
+
+//Bounds of the cells in [begin, end), from their world matrices
+void updateCellBounds(size_t begin, size_t end) {
+	size_t cell;
+	for(cell = begin; cell < end; ++cell) {
+		float const *m = sceneNodeWorld(surface_scene, cell + 1)->data;
+
+		//The local box's centre goes through m, and its half-extents through |m|
+		size_t axis;
+		for(axis = 0; axis < 3; ++axis) {
+			cell_center[axis][cell] = m[axis] * local_center[0] + m[4 + axis] * local_center[1] + m[8 + axis] * local_center[2] + m[12 + axis];
+			cell_extent[axis][cell] = fabsf(m[axis]) * local_extent[0] + fabsf(m[4 + axis]) * local_extent[1] + fabsf(m[8 + axis]) * local_extent[2];
+		}
+	}
+}
+
+//Packs the model matrices of the cells c can see into models
+void cullSurface(camera const *c, mat4 *models) {
+	frustum view_frustum;
+	frustumFromMat4(&view_frustum, &c->view_projection);
+
+	size_t count = frustumCullBoxes(&view_frustum, cell_center[0], cell_center[1], cell_center[2],
+									cell_extent[0], cell_extent[1], cell_extent[2], (size_t) surface_width * surface_length, visible_cells);
+
+	size_t i;
+	for(i = 0; i < count; ++i) {
+		models[i] = *sceneNodeWorld(surface_scene, visible_cells[i] + 1);
+	}
+
+	visible_cell_count = count;
+}
+
+void buildSurfaceInstances(void) {
+	size_t cell_count = (size_t) surface_width * surface_length;
+	surface_scene = createSceneGraph(cell_count + 1);
+	assert(surface_scene != NULL);
+
+	mat4 identity;
+	makeIdentityMat4(&identity);
+	surface_root = addSceneNode(surface_scene, SCENE_NO_PARENT, &identity);
+
+	quat rotation;
+	makeIdentityQuat(&rotation);
+
+	vec3 scale;
+	setVec3(&scale, surfaceUnitLength, surfaceUnitLength, surfaceUnitLength);
+
+	size_t c, a;
+	for(a = 0; a < surface_length; ++a) {
+		for(c = 0; c < surface_width; ++c) {
+			vec3 position;
+			setVec3(&position,
+					c*surfaceUnitLength - (surface_width * surfaceUnitLength * 0.5f),
+					0.0f,
+					a*surfaceUnitLength - (surface_length * surfaceUnitLength * 0.5f));
+
+			mat4 modelMatrix;
+			trsMat4(&modelMatrix, &position, &rotation, &scale);
+
+			size_t node = addSceneNode(surface_scene, surface_root, &modelMatrix);
+			assert(node != SCENE_NO_PARENT);
+		}
+	}
+
+	updateSceneGraph(surface_scene);
+
+	glBindBuffer(GL_ARRAY_BUFFER, instance_buffer);
+
+	if(culling) {
+		size_t axis;
+		for(axis = 0; axis < 3; ++axis) {
+			cell_center[axis] = malloc(cell_count * sizeof(float));
+			cell_extent[axis] = malloc(cell_count * sizeof(float));
+			assert(cell_center[axis] != NULL && cell_extent[axis] != NULL);
+		}
+
+		visible_cells = malloc(cell_count * sizeof(unsigned int));
+		assert(visible_cells != NULL);
+
+		updateCellBounds(0, cell_count);
+
+		//Filled in by the first frame, since the camera starts out dirty
+		glBufferData(GL_ARRAY_BUFFER, cell_count * sizeof(mat4), NULL, GL_DYNAMIC_DRAW);
+	} else {
+		glBufferData(GL_ARRAY_BUFFER, cell_count * sizeof(mat4), surface_scene->world + 1, GL_DYNAMIC_DRAW);
+		visible_cell_count = cell_count;
+	}
+}
+
+/*Frame pipeline
+ *Everything a frame needs worked out before it can be drawn - the camera's matrices, the scene graph, the culled and packed
+ *model matrices - goes into a frame_packet. While the main thread draws frame N from one packet, a worker thread builds frame
+ *N + 1's in the other, so that work overlaps with the driver's. The worker owns surface_scene, the cell bounds and frame_camera
+ *from the moment the pipeline starts; the main thread only hands it a copy of scene_camera with each request
+ *Requests and finished packets are counted with atomics, and as long as neither thread gets ahead of the other that's all they
+ *look at. The mutex is only taken by a thread that finds it has to wait, and by the other one to wake it up
+ *Each frame asks for the next one's packet, from the input as it is at that point, so input shows up a frame later than it
+ *would if frames were built and drawn in one go. --no-pipeline builds the packets on the main thread instead, in the same order*/
+typedef struct {
+	camera camera;			//with upload_dirty set if its matrices changed since the previous packet's
+	mat4 *models;			//one per cell, of which [first_model, first_model + model_count) have to be uploaded
+	size_t first_model;
+	size_t model_count;
+	GLsizei cell_count;		//instances to draw
+	double prepare_time;	//seconds
+} frame_packet;
+
+typedef struct {
+	frame_packet packets[2];	//packet n is packets[n % 2]
+	camera input;				//scene_camera, as of the latest request
+
+	atomic_ulong requested;		//packets asked for so far
+	atomic_ulong prepared;		//packets finished so far
+	unsigned long taken;		//packets the main thread has drawn from
+
+	int threaded;
+	atomic_int stopping;
+	atomic_int main_waiting;
+	atomic_int worker_waiting;
+
+	pthread_t worker;
+	pthread_mutex_t lock;
+	pthread_cond_t wake_main;
+	pthread_cond_t wake_worker;
+} frame_pipeline;
+
+frame_pipeline pipeline;
+
+//Cleared with --no-pipeline
+int pipeline_thread = 1;
+
+//The camera the packets are built from, which the worker keeps up to date with pipeline.input
+camera frame_camera;
+
+//Blocks until *counter is above value, or the pipeline is stopping; returns 0 in the latter case
+//waiting must only ever be set by the calling thread, and wake signalled by publishCount
+int waitForCount(atomic_ulong *counter, unsigned long value, atomic_int *waiting, pthread_cond_t *wake) {
+	if(atomic_load(counter) > value) {
+		return 1;
+	}
+
+	//Setting waiting before looking at counter again, and publishCount doing the opposite, means one of them sees the other
+	pthread_mutex_lock(&pipeline.lock);
+	atomic_store(waiting, 1);
+
+	while(atomic_load(counter) <= value && !atomic_load(&pipeline.stopping)) {
+		pthread_cond_wait(wake, &pipeline.lock);
+	}
+
+	atomic_store(waiting, 0);
+	pthread_mutex_unlock(&pipeline.lock);
+
+	return atomic_load(counter) > value;
+}
+
+void publishCount(atomic_ulong *counter, unsigned long value, atomic_int *waiting, pthread_cond_t *wake) {
+	atomic_store(counter, value);
+
+	if(atomic_load(waiting)) {
+		pthread_mutex_lock(&pipeline.lock);
+		pthread_cond_signal(wake);
+		pthread_mutex_unlock(&pipeline.lock);
+	}
+}
+
+//Takes whatever moved the camera since the last request
+void copyCameraInput(camera *c, camera const *input) {
+	c->eye = input->eye;
+	c->at = input->at;
+	c->up = input->up;
+
+	c->left = input->left;
+	c->right = input->right;
+	c->bottom = input->bottom;
+	c->top = input->top;
+	c->z_near = input->z_near;
+	c->z_far = input->z_far;
+
+	c->view_dirty |= input->view_dirty;
+	c->projection_dirty |= input->projection_dirty;
+	c->uniform_buffer = input->uniform_buffer;
+}
+
+//What drawSurface used to do before drawing - on the worker, unless the pipeline runs on the main thread
+void prepareFramePacket(frame_packet *packet) {
+	double const start = nowSeconds();
+
+	copyCameraInput(&frame_camera, &pipeline.input);
+	int const camera_moved = updateCamera(&frame_camera);
+	size_t const moved = updateSceneGraph(surface_scene);
+
+	packet->camera = frame_camera;
+	frame_camera.upload_dirty = 0;
+
+	packet->first_model = 0;
+	packet->model_count = 0;
+
+	if(culling && (moved > 0 || camera_moved)) {
+		if(moved > 0 && surface_scene->updated_end > 1) {
+			size_t const first_cell = surface_scene->updated_begin > 0 ? surface_scene->updated_begin - 1 : 0;
+			updateCellBounds(first_cell, surface_scene->updated_end - 1);
+		}
+
+		cullSurface(&frame_camera, packet->models);
+		packet->model_count = visible_cell_count;
+	} else if(!culling && moved > 0) {
+		//Only the model matrices updateSceneGraph rewrote, left where they are in instance_buffer
+		size_t const begin = surface_scene->updated_begin > 0 ? surface_scene->updated_begin : 1;
+		size_t const end = surface_scene->updated_end;
+
+		if(end > begin) {
+			memcpy(packet->models + begin - 1, surface_scene->world + begin, (end - begin) * sizeof(mat4));
+			packet->first_model = begin - 1;
+			packet->model_count = end - begin;
+		}
+	}
+
+	packet->cell_count = visible_cell_count;
+	packet->prepare_time = nowSeconds() - start;
+}
+
+void *framePipelineWorker(void *arg) {
+	(void) arg;
+
+	unsigned long packet;
+	for(packet = 0; waitForCount(&pipeline.requested, packet, &pipeline.worker_waiting, &pipeline.wake_worker); ++packet) {
+		prepareFramePacket(pipeline.packets + packet % 2);
+		publishCount(&pipeline.prepared, packet + 1, &pipeline.main_waiting, &pipeline.wake_main);
+	}
+
+	return NULL;
+}
+
+//Asks for the next packet, built from scene_camera as it is now; returns whether it changed since the previous request
+//Only ever called once the previous request's packet has been taken, so the worker is done with pipeline.input and the slot
+int requestFramePacket(void) {
+	int const changed = scene_camera.view_dirty || scene_camera.projection_dirty;
+
+	pipeline.input = scene_camera;
+	scene_camera.view_dirty = 0;
+	scene_camera.projection_dirty = 0;
+
+	unsigned long const packet = atomic_load_explicit(&pipeline.requested, memory_order_relaxed);
+
+	if(pipeline.threaded) {
+		publishCount(&pipeline.requested, packet + 1, &pipeline.worker_waiting, &pipeline.wake_worker);
+	} else {
+		prepareFramePacket(pipeline.packets + packet % 2);
+		atomic_store(&pipeline.requested, packet + 1);
+		atomic_store(&pipeline.prepared, packet + 1);
+	}
+
+	return changed;
+}
+
+//Waits for the oldest packet not drawn yet, and asks for the one after it
+frame_packet *nextFramePacket(void) {
+	waitForCount(&pipeline.prepared, pipeline.taken, &pipeline.main_waiting, &pipeline.wake_main);
+	frame_packet *packet = pipeline.packets + pipeline.taken++ % 2;
+
+	frame_pending = requestFramePacket();
+
+	return packet;
+}
 
-	//Note that these string literals will be automatically concatenated into a single one
-	char const * const vtx_shd = "uniform mat4 mModel;"
-								 "uniform mat4 mView;"
-								 "uniform mat4 mProjection;"
-								 "attribute vec3 vPosition;"
-								 "void main() {"
-									"gl_Position = mProjection * mView * mModel * vec4(vPosition, 1.0);"
-								 "}";
+//Needs initScene to have run, and any input for the first frame to be in
+void startFramePipeline(void) {
+	size_t const cell_count = (size_t) surface_width * surface_length;
+
+	size_t i;
+	for(i = 0; i < 2; ++i) {
+		pipeline.packets[i].models = malloc(cell_count * sizeof(mat4));
+		assert(pipeline.packets[i].models != NULL);
+	}
+
+	pthread_mutex_init(&pipeline.lock, NULL);
+	pthread_cond_init(&pipeline.wake_main, NULL);
+	pthread_cond_init(&pipeline.wake_worker, NULL);
+
+	if(pipeline_thread) {
+		pipeline.threaded = (pthread_create(&pipeline.worker, NULL, framePipelineWorker, NULL) == 0);
+
+		if(!pipeline.threaded) {
+			fprintf(stderr, "Couldn't start the frame pipeline's thread, so frames will be prepared on the main one\n");
+		}
+	}
+
+	//There's no frame before the first one to overlap with
+	requestFramePacket();
+}
+
+void stopFramePipeline(void) {
+	if(pipeline.threaded) {
+		pthread_mutex_lock(&pipeline.lock);
+		atomic_store(&pipeline.stopping, 1);
+		pthread_cond_signal(&pipeline.wake_worker);
+		pthread_mutex_unlock(&pipeline.lock);
+
+		pthread_join(pipeline.worker, NULL);
+		pipeline.threaded = 0;
+	}
+}
+
+void uploadSurfaceInstances(frame_packet const *packet) {
+	stateBindBuffer(GL_ARRAY_BUFFER, instance_buffer);
+	glBufferSubData(GL_ARRAY_BUFFER, packet->first_model * sizeof(mat4), packet->model_count * sizeof(mat4), packet->models + packet->first_model);
+
+	++current_stats.state_changes;
+}
+
+//How long initShaders took, for the headless report
+double program_load_time;
+
+//Everything that only needs a current GL context, shared by the windowed and headless modes
+//Returns 0 if the shaders couldn't be built
+int initScene(void) {
+	//Set up the program
+	double program_start = nowSeconds();
+	program = initShaders();
+	program_load_time = nowSeconds() - program_start;
+
+	if(program == 0) {
+		return 0;
+	}
+
+	glUseProgram(program);
+
+	//Everything the draws read from is captured once in a vertex array object, so a frame only has to bind that
+	glGenVertexArrays(1, &scene_vertex_array);
+	glBindVertexArray(scene_vertex_array);
+
+	GLuint *buffer = malloc(sizeof(GLuint) * 3);
+	glGenBuffers(3, buffer);
+	surface_vertex_buffer = *buffer;
+	surface_element_buffer = *(buffer+1);
+	instance_buffer = *(buffer + 2);
+	free(buffer);
+
+	//Mesh files were optimised when they were converted, but the cube's hand-written fans still need turning into a triangle list
+	if(surface_mesh == &cube_mesh) {
+		mesh *optimized = optimizeMesh(&cube_mesh, NULL, NULL);
+
+		if(optimized != NULL) {
+			surface_mesh = optimized;
+		}
+	}
+
+	//Straight from the mesh - for a mesh file that's the mapping itself, which the driver reads without it ever being copied
+	mesh_stream const *positions = meshPositions(surface_mesh);
+
+	glBindBuffer(GL_ARRAY_BUFFER, surface_vertex_buffer);
+	glBufferData(GL_ARRAY_BUFFER, sizeof(float) * positions->components * surface_mesh->vertex_count, positions->data, GL_STATIC_DRAW);
+
+	//Every part shares one element buffer, so switching between them is just a different offset
+	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, surface_element_buffer);
+	glBufferData(GL_ELEMENT_ARRAY_BUFFER, surface_mesh->index_size * surface_mesh->index_count, surface_mesh->indices, GL_STATIC_DRAW);
+
+	surface_index_size = surface_mesh->index_size;
+	surface_index_type = (surface_index_size == 1 ? GL_UNSIGNED_BYTE : (surface_index_size == 2 ? GL_UNSIGNED_SHORT : GL_UNSIGNED_INT));
+
+	surface_part_count = surface_mesh->part_count;
+	surface_parts = malloc(sizeof(mesh_part) * surface_part_count);
+	memcpy(surface_parts, surface_mesh->parts, sizeof(mesh_part) * surface_part_count);
+
+	setLocalBounds(surface_mesh->bounds_min, surface_mesh->bounds_max);
+
+	buildSurfaceInstances();
+
+	glGenQueries(GPU_QUERY_COUNT, gpu_queries);
+	current_stats.gpu_time = -1.0;
+
+	//The vertex layout never changes, so it's only specified once
+	glBindBuffer(GL_ARRAY_BUFFER, surface_vertex_buffer);
+	GLint vPosition = glGetAttribLocation(program, "vPosition");
+	glVertexAttribPointer(vPosition, positions->components, GL_FLOAT, GL_FALSE, 0, 0);
+	glEnableVertexAttribArray(vPosition);
+
+	if(surface_mesh != &cube_mesh) {
+		closeMesh(surface_mesh);
+		surface_mesh = NULL;
+	}
+
+	//A mat4 attribute takes four consecutive locations, one per column, each advancing once per instance
+	glBindBuffer(GL_ARRAY_BUFFER, instance_buffer);
+	GLint mModel = glGetAttribLocation(program, "mModel");
+	size_t column;
+	for(column = 0; column < 4; ++column) {
+		glVertexAttribPointer(mModel + column, 4, GL_FLOAT, GL_FALSE, sizeof(mat4), (void *) (column * 4 * sizeof(float)));
+		glVertexAttribDivisor(mModel + column, 1);
+		glEnableVertexAttribArray(mModel + column);
+	}
+
+	glClearColor(0.0, 0.0, 0.0, 1.0);
+	
+	glUniformBlockBinding(program, glGetUniformBlockIndex(program, "Camera"), CAMERA_BINDING);
+	initCamera(&scene_camera);
+
+	makeIdentityMat4(&surface_local);
+	scaleMat4(&outline_local, OUTLINE_SCALE);
+
+	mLocalLoc = glGetUniformLocation(program, "mLocal");
+	
+	modeLoc = glGetUniformLocation(program, "mode");
+
+	glDepthMask(GL_TRUE);
+	glEnable(GL_DEPTH_TEST);
+	glDepthFunc(GL_LEQUAL);
+
+	//All of the above was set directly, so the shadowing wrappers can't assume anything about it
+	forgetGLState();
+
+	return 1;
+}
+
+/*Overlay text
+ *GLUT's 8x13 bitmap font is drawn into a texture, the glyph atlas, once when the window opens. From then on, a frame's text
+ *is only written into an array of quads, one per visible character, which is uploaded and drawn with a single call - rather than
+ *every character being its own glBitmap*/
+#define GLYPH_FIRST 32			//' '
+#define GLYPH_COUNT 95			//' ' to '~'
+#define GLYPH_ADVANCE 8
+#define GLYPH_CELL_WIDTH 8
+#define GLYPH_CELL_HEIGHT 20	//the font's 13 rows, with room either side of them wherever GLUT puts them around the baseline
+#define GLYPH_BASELINE 4		//from the bottom of a cell
+#define ATLAS_COLUMNS 16
+#define ATLAS_ROWS 6
+#define TEXT_LINE_HEIGHT 13
+#define TEXT_MAX_GLYPHS 2048	//more are dropped; with four vertices each, GL_UNSIGNED_SHORT indices are enough
 
-	glShaderSource(vertex_shader, 1, &vtx_shd, NULL);
-	glCompileShader(vertex_shader);
+typedef struct {
+	float x, y;		//normalised device coordinates
+	float u, v;		//in atlas texels
+} text_vertex;
 
-	//Creating the fragment shader
-	GLuint fragment_shader = glCreateShader(GL_FRAGMENT_SHADER);
+text_vertex text_vertices[TEXT_MAX_GLYPHS * 4];
+size_t text_glyph_count = 0;
 
-	char const * const frg_shd = "uniform bool mode;"
+GLuint text_program;
+GLuint text_vertex_array;
+GLuint text_vertex_buffer;
+GLuint text_element_buffer;
+GLuint glyph_atlas;
+
+//Draws the font with GLUT, so it can only be done in windowed mode
+//Returns 0 on failure, having printed why
+int initText(void) {
+	//z = -1 puts the text in front of everything, so it passes the scene's depth test
+	char const * const vtx_shd = "#version 330\n"
+								 "in vec2 vCorner;"
+								 "in vec2 vTexel;"
+								 "out vec2 texel;"
 								 "void main() {"
-									 "if(mode) {"
-										"gl_FragColor = vec4(0.62745098039, 0.55686274509, 0.09411764705, 1.0);"
-									 "} else {"
-										"gl_FragColor = vec4(0.3725490196, 0.0, 0.90588235294, 1.0);"
+									"texel = vTexel;"
+									"gl_Position = vec4(vCorner, -1.0, 1.0);"
+								 "}";
+
+	char const * const frg_shd = "#version 330\n"
+								 "uniform sampler2D atlas;"
+								 "uniform vec4 color;"
+								 "in vec2 texel;"
+								 "out vec4 fragColor;"
+								 "void main() {"
+									 "if(texelFetch(atlas, ivec2(texel), 0).r < 0.5) {"
+										"discard;"
 									 "}"
+									 "fragColor = color;"
 								 "}";
 
-	glShaderSource(fragment_shader, 1, &frg_shd, NULL);
-	glCompileShader(fragment_shader);
+	text_program = loadProgram(vtx_shd, frg_shd);
+	if(text_program == 0) {
+		return 0;
+	}
 
-	//Creating the program
-	GLuint program = glCreateProgram();
+	int const atlas_width = ATLAS_COLUMNS * GLYPH_CELL_WIDTH;
+	int const atlas_height = ATLAS_ROWS * GLYPH_CELL_HEIGHT;
 
-	glAttachShader(program, vertex_shader);
-	glAttachShader(program, fragment_shader);
-	glLinkProgram(program);
+	glGenTextures(1, &glyph_atlas);
+	glBindTexture(GL_TEXTURE_2D, glyph_atlas);
+	glTexImage2D(GL_TEXTURE_2D, 0, GL_R8, atlas_width, atlas_height, 0, GL_RED, GL_UNSIGNED_BYTE, NULL);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
 
-	return program;
+	GLint previous_framebuffer;
+	glGetIntegerv(GL_FRAMEBUFFER_BINDING, &previous_framebuffer);
+
+	GLuint framebuffer;
+	glGenFramebuffers(1, &framebuffer);
+	glBindFramebuffer(GL_FRAMEBUFFER, framebuffer);
+	glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, glyph_atlas, 0);
+
+	if(glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE) {
+		fprintf(stderr, "Could not create the glyph atlas\n");
+		glBindFramebuffer(GL_FRAMEBUFFER, previous_framebuffer);
+		glDeleteFramebuffers(1, &framebuffer);
+
+		return 0;
+	}
+
+	//Without a program, glBitmap writes the current colour; the framebuffer has no depth buffer, so the depth test always passes
+	glUseProgram(0);
+	glViewport(0, 0, atlas_width, atlas_height);
+	glClear(GL_COLOR_BUFFER_BIT);
+	glColor3f(1.0f, 1.0f, 1.0f);
+
+	int glyph;
+	for(glyph = 0; glyph < GLYPH_COUNT; ++glyph) {
+		glWindowPos2i((glyph % ATLAS_COLUMNS) * GLYPH_CELL_WIDTH, (glyph / ATLAS_COLUMNS) * GLYPH_CELL_HEIGHT + GLYPH_BASELINE);
+		glutBitmapCharacter(GLUT_BITMAP_8_BY_13, GLYPH_FIRST + glyph);
+	}
+
+	glBindFramebuffer(GL_FRAMEBUFFER, previous_framebuffer);
+	glDeleteFramebuffers(1, &framebuffer);
+	glViewport(0, 0, window_width, window_height);
+
+	//Every quad is two triangles over the same four vertices, so the indices never change
+	GLushort *indices = malloc(sizeof(GLushort) * 6 * TEXT_MAX_GLYPHS);
+	size_t i;
+	for(i = 0; i < TEXT_MAX_GLYPHS; ++i) {
+		GLushort const first = (GLushort) (i * 4);
+		GLushort const quad[6] = {first, first + 1, first + 2, first, first + 2, first + 3};
+
+		memcpy(indices + i*6, quad, sizeof(quad));
+	}
+
+	GLuint buffers[2];
+	glGenBuffers(2, buffers);
+	text_vertex_buffer = buffers[0];
+	text_element_buffer = buffers[1];
+
+	glGenVertexArrays(1, &text_vertex_array);
+	glBindVertexArray(text_vertex_array);
+
+	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, text_element_buffer);
+	glBufferData(GL_ELEMENT_ARRAY_BUFFER, sizeof(GLushort) * 6 * TEXT_MAX_GLYPHS, indices, GL_STATIC_DRAW);
+	free(indices);
+
+	glBindBuffer(GL_ARRAY_BUFFER, text_vertex_buffer);
+	glBufferData(GL_ARRAY_BUFFER, sizeof(text_vertices), NULL, GL_STREAM_DRAW);
+
+	GLint vCorner = glGetAttribLocation(text_program, "vCorner");
+	glVertexAttribPointer(vCorner, 2, GL_FLOAT, GL_FALSE, sizeof(text_vertex), (void *) 0);
+	glEnableVertexAttribArray(vCorner);
+
+	GLint vTexel = glGetAttribLocation(text_program, "vTexel");
+	glVertexAttribPointer(vTexel, 2, GL_FLOAT, GL_FALSE, sizeof(text_vertex), (void *) (2 * sizeof(float)));
+	glEnableVertexAttribArray(vTexel);
+
+	//The atlas stays bound to unit 0, which nothing else uses; the colour is the outlines', which glBitmap used to get from the scene's shader
+	glUseProgram(text_program);
+	glUniform1i(glGetUniformLocation(text_program, "atlas"), 0);
+	glUniform4f(glGetUniformLocation(text_program, "color"), 0.3725490196f, 0.0f, 0.90588235294f, 1.0f);
+
+	glBindVertexArray(scene_vertex_array);
+	glUseProgram(program);
+	forgetGLState();
+
+	return 1;
 }
 
-GLint mModelLoc;
-GLint mViewLoc;
-GLint mProjectionLoc;
-GLint modeLoc;
+//Queues text with its first character's baseline at (x, y) in window pixels, counted from the bottom left
+void addText(int x, int y, char const *text) {
+	for(; *text != '\0'; ++text, x += GLYPH_ADVANCE) {
+		int const glyph = (unsigned char) *text - GLYPH_FIRST;
 
-GLuint cube_vertex_buffer;
-GLuint cube_element_buffer;
-GLuint second_cube_element_buffer;
+		//Spaces (and anything the font hasn't got) only move along
+		if(glyph <= 0 || glyph >= GLYPH_COUNT || text_glyph_count == TEXT_MAX_GLYPHS) {
+			continue;
+		}
 
-GLuint program;
+		float const left = 2.0f * x / window_width - 1.0f;
+		float const right = 2.0f * (x + GLYPH_CELL_WIDTH) / window_width - 1.0f;
+		float const bottom = 2.0f * (y - GLYPH_BASELINE) / window_height - 1.0f;
+		float const top = 2.0f * (y - GLYPH_BASELINE + GLYPH_CELL_HEIGHT) / window_height - 1.0f;
 
-float cube_vertices[3 * 8] = {-0.5, 0.5, 0.5, 0.5, 0.5, 0.5, 0.5, -0.5, 0.5, -0.5, -0.5, 0.5,
-							  -0.5, 0.5, -0.5, 0.5, 0.5, -0.5, 0.5, -0.5, -0.5, -0.5, -0.5, -0.5};
+		float const u = (float) ((glyph % ATLAS_COLUMNS) * GLYPH_CELL_WIDTH);
+		float const v = (float) ((glyph / ATLAS_COLUMNS) * GLYPH_CELL_HEIGHT);
 
-unsigned char cube_indices[8] = {0, 1, 2, 3, 7, 4, 5, 1};
-unsigned char second_cube_indices[8] = {6, 2, 3, 7, 4, 5, 1, 2};
+		text_vertex const quad[4] = {{left, bottom, u, v},
+									 {right, bottom, u + GLYPH_CELL_WIDTH, v},
+									 {right, top, u + GLYPH_CELL_WIDTH, v + GLYPH_CELL_HEIGHT},
+									 {left, top, u, v + GLYPH_CELL_HEIGHT}};
 
-float horizontal_movement = 0.0;
-float vertical_movement = 0.0;
-float depth_movement = 0.0;
-void keyboard(int key, int x, int y) {
-	switch(key) {
-		case GLUT_KEY_LEFT:
-			horizontal_movement -= 0.01f;
-			break;
-		case GLUT_KEY_RIGHT:
-			horizontal_movement += 0.01f;
-			break;
-		case GLUT_KEY_UP:
-			vertical_movement += 0.01f;
-			break;
-		case GLUT_KEY_DOWN:
-			vertical_movement -= 0.01f;
-			break;
-		case GLUT_KEY_PAGE_UP:
-			depth_movement -= 0.01f;
-			break;
-		case GLUT_KEY_PAGE_DOWN:
-			depth_movement += 0.01f;
-			break;
+		memcpy(text_vertices + text_glyph_count*4, quad, sizeof(quad));
+		++text_glyph_count;
+	}
+}
+
+//Draws everything queued since the last call
+void drawText(void) {
+	if(text_glyph_count == 0) {
+		return;
+	}
+
+	stateUseProgram(text_program);
+	stateBindVertexArray(text_vertex_array);
+	stateBindBuffer(GL_ARRAY_BUFFER, text_vertex_buffer);
+
+	//Orphaning last frame's vertices first, so the driver doesn't wait for them to be drawn before taking the new ones
+	glBufferData(GL_ARRAY_BUFFER, sizeof(text_vertices), NULL, GL_STREAM_DRAW);
+	glBufferSubData(GL_ARRAY_BUFFER, 0, sizeof(text_vertex) * 4 * text_glyph_count, text_vertices);
+	++current_stats.state_changes;
+
+	drawElements(GL_TRIANGLES, (GLsizei) (6 * text_glyph_count), GL_UNSIGNED_SHORT, 0);
+
+	text_glyph_count = 0;
+}
+
+int headless = 0;
+
+#ifndef _WIN32
+/*Headless mode
+ *Renders into a framebuffer object on a surfaceless EGL context, so it runs without a window system - with Mesa's llvmpipe, without a GPU*/
+int initHeadlessContext(void) {
+	PFNEGLGETPLATFORMDISPLAYEXTPROC getPlatformDisplay = (PFNEGLGETPLATFORMDISPLAYEXTPROC) eglGetProcAddress("eglGetPlatformDisplayEXT");
+	EGLDisplay display = (getPlatformDisplay != NULL ? getPlatformDisplay(EGL_PLATFORM_SURFACELESS_MESA, EGL_DEFAULT_DISPLAY, NULL) : eglGetDisplay(EGL_DEFAULT_DISPLAY));
+
+	if(display == EGL_NO_DISPLAY || !eglInitialize(display, NULL, NULL) || !eglBindAPI(EGL_OPENGL_API)) {
+		fprintf(stderr, "Could not initialise EGL (error 0x%x)\n", eglGetError());
+
+		return 0;
+	}
+
+	EGLint const context_attributes[] = {EGL_CONTEXT_MAJOR_VERSION, 3,
+										 EGL_CONTEXT_MINOR_VERSION, 3,
+										 EGL_CONTEXT_OPENGL_PROFILE_MASK, EGL_CONTEXT_OPENGL_COMPATIBILITY_PROFILE_BIT,
+										 EGL_NONE};
+	EGLContext context = eglCreateContext(display, (EGLConfig) 0, EGL_NO_CONTEXT, context_attributes);
+
+	if(context == EGL_NO_CONTEXT || !eglMakeCurrent(display, EGL_NO_SURFACE, EGL_NO_SURFACE, context)) {
+		fprintf(stderr, "Could not create a surfaceless OpenGL 3.3 context (error 0x%x)\n", eglGetError());
+
+		return 0;
+	}
+
+	GLuint framebuffer, renderbuffers[2];
+	glGenFramebuffers(1, &framebuffer);
+	glGenRenderbuffers(2, renderbuffers);
+
+	glBindRenderbuffer(GL_RENDERBUFFER, renderbuffers[0]);
+	glRenderbufferStorage(GL_RENDERBUFFER, GL_RGBA8, WINDOW_WIDTH, WINDOW_HEIGHT);
+	glBindRenderbuffer(GL_RENDERBUFFER, renderbuffers[1]);
+	glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH_COMPONENT24, WINDOW_WIDTH, WINDOW_HEIGHT);
+
+	glBindFramebuffer(GL_FRAMEBUFFER, framebuffer);
+	glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_RENDERBUFFER, renderbuffers[0]);
+	glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_RENDERBUFFER, renderbuffers[1]);
+	glViewport(0, 0, WINDOW_WIDTH, WINDOW_HEIGHT);
+
+	if(glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE) {
+		fprintf(stderr, "Could not create the offscreen framebuffer\n");
+
+		return 0;
+	}
+
+	printf("Rendering headless on %s (%s)\n", glGetString(GL_RENDERER), glGetString(GL_VERSION));
+
+	return 1;
+}
+
+int compareFrameTimes(void const *a, void const *b) {
+	double const x = *(double const *) a;
+	double const y = *(double const *) b;
+
+	return (x > y) - (x < y);
+}
+
+//Nearest-rank percentile of an already sorted array
+double percentile(double const *sorted, size_t count, double p) {
+	size_t rank = (size_t) ceil(p / 100.0 * count);
+
+	return sorted[rank > 0 ? rank - 1 : 0];
+}
+
+//Renders frame_count frames, then reports the frame time and how much of the last frame was drawn on
+//With frame_count == 0, only reports how long the shader program took to load
+int runHeadless(unsigned int frame_count) {
+	if(!initHeadlessContext()) {
+		return 1;
 	}
+
+	if(!initScene()) {
+		return 1;
+	}
+
+	printf("Shader program %s in %.3f ms\n", program_from_cache ? "loaded from the cache" : "compiled", program_load_time * 1e3);
+
+	if(frame_count == 0) {
+		return 0;
+	}
+
+	replayCameraPath(0);
+	startFramePipeline();
+
+	double *frame_times = malloc(frame_count * sizeof(double));
+	double total = 0.0;
+
+	unsigned int frame;
+	for(frame = 0; frame < frame_count; ++frame) {
+		//The packet for the frame after this one is asked for while this one is drawn, so its input has to be in by then
+		replayCameraPath(frame + 1);
+
+		double const start = nowSeconds();
+		render();
+		frame_times[frame] = (nowSeconds() - start) * 1000.0;
+
+		total += frame_times[frame];
+	}
+
+	unsigned char *pixels = malloc(WINDOW_WIDTH * WINDOW_HEIGHT * 4);
+	glReadPixels(0, 0, WINDOW_WIDTH, WINDOW_HEIGHT, GL_RGBA, GL_UNSIGNED_BYTE, pixels);
+
+	size_t i, covered = 0;
+	for(i = 0; i < WINDOW_WIDTH * WINDOW_HEIGHT; ++i) {
+		if(pixels[i*4] != 0 || pixels[i*4 + 1] != 0 || pixels[i*4 + 2] != 0) {
+			++covered;
+		}
+	}
+
+	free(pixels);
+
+	qsort(frame_times, frame_count, sizeof(double), compareFrameTimes);
+
+	printf("%ux%u grid: %u frames, %.1f%% of the last frame covered\n",
+		   surface_width, surface_length, frame_count, 100.0 * covered / (WINDOW_WIDTH * WINDOW_HEIGHT));
+	printf("frame ms: mean %.3f, min %.3f, p50 %.3f, p90 %.3f, p99 %.3f, max %.3f\n",
+		   total / frame_count, frame_times[0], percentile(frame_times, frame_count, 50.0),
+		   percentile(frame_times, frame_count, 90.0), percentile(frame_times, frame_count, 99.0), frame_times[frame_count - 1]);
+
+	free(frame_times);
+	stopFramePipeline();
+
+	return 0;
 }
+#endif
 
 int main(int argc, char **argv) {
+	//Defaults to the length of the camera path
+	unsigned int frame_count = 0;
+	int frame_count_given = 0;
+
+	shader_cache_directory = defaultShaderCacheDirectory();
+
+	int i;
+	for(i = 1; i < argc; ++i) {
+		if(strcmp(argv[i], "--headless") == 0) {
+			headless = 1;
+		} else if(strncmp(argv[i], "--frames=", 9) == 0) {
+			char *end;
+			frame_count = strtoul(argv[i] + 9, &end, 10);
+
+			if(end == argv[i] + 9 || *end != '\0') {
+				fprintf(stderr, "--frames expects a number of frames, such as --frames=600\n");
+
+				return 1;
+			}
+
+			frame_count_given = 1;
+		} else if(strncmp(argv[i], "--stats-csv=", 12) == 0) {
+			if(!openStatisticsCSV(argv[i] + 12)) {
+				return 1;
+			}
+		} else if(strncmp(argv[i], "--grid=", 7) == 0) {
+			if(sscanf(argv[i] + 7, "%ux%u", &surface_width, &surface_length) != 2 || surface_width == 0 || surface_length == 0) {
+				fprintf(stderr, "--grid expects WIDTHxLENGTH, such as --grid=1000x1000\n");
+
+				return 1;
+			}
+		} else if(strcmp(argv[i], "--no-culling") == 0) {
+			culling = 0;
+		} else if(strcmp(argv[i], "--no-pipeline") == 0) {
+			pipeline_thread = 0;
+		} else if(strncmp(argv[i], "--fps=", 6) == 0) {
+			target_fps = strtoul(argv[i] + 6, NULL, 10);
+		} else if(strcmp(argv[i], "--vsync") == 0) {
+			vsync = 1;
+		} else if(strncmp(argv[i], "--shader-cache=", 15) == 0) {
+			shader_cache_directory = argv[i] + 15;
+		} else if(strcmp(argv[i], "--no-shader-cache") == 0) {
+			shader_cache_directory = NULL;
+		} else if(strncmp(argv[i], "--mesh=", 7) == 0) {
+			char const *error;
+			surface_mesh = openMesh(argv[i] + 7, &error);
+
+			if(surface_mesh == NULL) {
+				fprintf(stderr, "Couldn't load %s: %s\n", argv[i] + 7, error);
+
+				return 1;
+			}
+
+			if(meshPositions(surface_mesh) == NULL) {
+				fprintf(stderr, "Couldn't load %s: it has no positions\n", argv[i] + 7);
+
+				return 1;
+			}
+		} else if(strncmp(argv[i], "--camera-path=", 14) == 0) {
+			if(!loadCameraPath(argv[i] + 14)) {
+				return 1;
+			}
+		} else if(strncmp(argv[i], "--record-camera-path=", 21) == 0) {
+			camera_recording = fopen(argv[i] + 21, "w");
+			if(camera_recording == NULL) {
+				fprintf(stderr, "Couldn't open %s for writing\n", argv[i] + 21);
+
+				return 1;
+			}
+		}
+	}
+
+	if(!frame_count_given) {
+		frame_count = cameraPathFrames();
+	}
+
+	if(headless) {
+#ifdef _WIN32
+		(void) frame_count;
+		fprintf(stderr, "Headless mode needs EGL, which this build doesn't have\n");
+
+		return 1;
+#else
+		return runHeadless(frame_count);
+#endif
+	}
+
 	//Window initialisation
     glutInit(&argc, argv);
 
@@ -109,44 +2027,28 @@ int main(int argc, char **argv) {
     glutInitDisplayMode(GLUT_RGBA | GLUT_DOUBLE | GLUT_DEPTH);
     int window = glutCreateWindow("OpenGL on Windows");
 
+#ifdef _WIN32
 	//Initiate GLEW
 	glewInit();
+#endif
 
-	//Set up the program
-	program = initShaders();
-	glUseProgram(program);
-
-	GLuint *buffer = malloc(sizeof(GLuint) * 3);
-	glGenBuffers(3, buffer);
-	cube_vertex_buffer = *buffer;
-	cube_element_buffer = *(buffer+1);
-	second_cube_element_buffer = *(buffer + 2);
-
-	glBindBuffer(GL_ARRAY_BUFFER, cube_vertex_buffer);
-	glBufferData(GL_ARRAY_BUFFER, sizeof(float) * 3 * 8, cube_vertices, GL_STATIC_DRAW);
-
-	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, cube_element_buffer);
-	glBufferData(GL_ELEMENT_ARRAY_BUFFER, sizeof(unsigned char) * 8, cube_indices, GL_STATIC_DRAW);
-
-	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, second_cube_element_buffer);
-	glBufferData(GL_ELEMENT_ARRAY_BUFFER, sizeof(unsigned char) * 8, second_cube_indices, GL_STATIC_DRAW);
+	if(!initScene() || !initText()) {
+		return 1;
+	}
 
-	glClearColor(0.0, 0.0, 0.0, 1.0);
-	
-	mModelLoc = glGetUniformLocation(program, "mModel");
-	mViewLoc = glGetUniformLocation(program, "mView");
-	mProjectionLoc = glGetUniformLocation(program, "mProjection");
-	
-	modeLoc = glGetUniformLocation(program, "mode");
+	startFramePipeline();
 
-	glDepthMask(GL_TRUE);
-	glEnable(GL_DEPTH_TEST);
-	glDepthFunc(GL_LEQUAL);
+	if(vsync && !setSwapInterval(1)) {
+		fprintf(stderr, "This driver can't synchronise with the display, so --vsync does nothing\n");
+	}
 
+	//Frames are drawn when GLUT is asked to redisplay, and idle is only registered while a key is held down
 	glutDisplayFunc(render);
-	glutIdleFunc(render);
 
-	glutSpecialFunc(keyboard);
+	glutIgnoreKeyRepeat(1);
+	glutSpecialFunc(keyDown);
+	glutSpecialUpFunc(keyUp);
+	glutReshapeFunc(reshape);
 
 	printf("\nIf you're seeing this message, it's because you tried compiling this program without -Wl,--subsystem,windows.\n"
 		   "Good on you for trying different things out.\n\n");
@@ -158,127 +2060,122 @@ int main(int argc, char **argv) {
     return 0;
 }
 
-void drawSurface(void);
+void drawSurface(frame_packet *packet);
+
+void printPosition(void);
+void printStatistics(void);
 
 void render(void) {
-	glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+	beginFrameStatistics();
 
-	drawSurface();
+	glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
 
-	glutSwapBuffers();
-}
+	frame_packet *packet = nextFramePacket();
+	endPhase(PHASE_MATH);
 
-void printPosition(void) {
-	size_t i;
-	
-	glWindowPos2i(10, glutGet(GLUT_WINDOW_HEIGHT) - 20);
-	char *msg1 = "Your eye is currently at";
-	size_t msg1_len = strlen(msg1);
-	for(i = 0; i < msg1_len; ++i) {
-		glutBitmapCharacter(GLUT_BITMAP_8_BY_13, *(msg1 + i));
+	//Whatever changed since this frame's packet was asked for is in the next one, which idle posts a frame for
+	if(!headless && frame_pending) {
+		glutIdleFunc(idle);
 	}
-	
-	glWindowPos2i(10, glutGet(GLUT_WINDOW_HEIGHT) - (20 + 13));
-	char *msg2_formatter = "X (horizontal, pointing right) = %.2f";
-	char msg2[strlen(msg2_formatter) - 4 + 4 + (horizontal_movement < 0 ? 1 : 0)];
-	sprintf(msg2, msg2_formatter, horizontal_movement);
-	size_t msg2_len = strlen(msg2);
-	for(i = 0; i < msg2_len; ++i) {
-		glutBitmapCharacter(GLUT_BITMAP_8_BY_13, *(msg2 + i));
-	}
-	
-	glWindowPos2i(10, glutGet(GLUT_WINDOW_HEIGHT) - (20 + 26));
-	char *msg3_formatter = "Y (vertical, pointing up) = %.2f";
-	char msg3[strlen(msg3_formatter) - 4 + 4 + (vertical_movement < 0 ? 1 : 0)];
-	sprintf(msg3, msg3_formatter, vertical_movement);
-	size_t msg3_len = strlen(msg3);
-	for(i = 0; i < msg3_len; ++i) {
-		glutBitmapCharacter(GLUT_BITMAP_8_BY_13, *(msg3 + i));
+
+	drawSurface(packet);
+
+	if(!headless) {
+		printPosition();
+		printStatistics();
+		drawText();
 	}
-	
-	glWindowPos2i(10, glutGet(GLUT_WINDOW_HEIGHT) - (20 + 39));
-	char *msg4_formatter = "Z (depth, pointing towards you) = %.2f";
-	char msg4[strlen(msg4_formatter) - 4 + 4 + (depth_movement < 0 ? 1 : 0)];
-	sprintf(msg4, msg4_formatter, depth_movement + 1.0f);
-	size_t msg4_len = strlen(msg4);
-	for(i = 0; i < msg4_len; ++i) {
-		glutBitmapCharacter(GLUT_BITMAP_8_BY_13, *(msg4 + i));
+	endPhase(PHASE_OVERLAY);
+
+	endFrameCommands();
+
+	if(headless) {
+		glFinish();
+	} else {
+		glutSwapBuffers();
 	}
+	endPhase(PHASE_SWAP);
+
+	endFrameStatistics();
 }
 
-const float surfaceUnitLength = 0.125f;
-void drawSurface(void) {
-	glBindBuffer(GL_ARRAY_BUFFER, cube_vertex_buffer);
-	GLint vPosition = glGetAttribLocation(program, "vPosition");
-	glVertexAttribPointer(vPosition, 3, GL_FLOAT, GL_FALSE, 0, 0);
-	glEnableVertexAttribArray(vPosition);
+void printOverlayLine(int line, char const *text) {
+	addText(10, window_height - (20 + TEXT_LINE_HEIGHT*line), text);
+}
+
+void printPosition(void) {
+	char line[64];
 
-	f_matrix *modelMatrix = scaleMatrix(surfaceUnitLength);
+	printOverlayLine(0, "Your eye is currently at");
 
-	f_vec *eye = createVec(3), *at = createVec(3), *up = createVec(3);
+	snprintf(line, sizeof(line), "X (horizontal, pointing right) = %.2f", horizontal_movement);
+	printOverlayLine(1, line);
 
-	setVecValue(eye, 0, 0.0f + horizontal_movement);
-	setVecValue(eye, 1, 0.0f + vertical_movement);
-	setVecValue(eye, 2, 1.0f + depth_movement);
+	snprintf(line, sizeof(line), "Y (vertical, pointing up) = %.2f", vertical_movement);
+	printOverlayLine(2, line);
 
-	printPosition();
-	
-	setVecValue(at, 0, 0.0f);
-	setVecValue(at, 1, 0.0f);
-	setVecValue(at, 2, 0.0f);
+	snprintf(line, sizeof(line), "Z (depth, pointing towards you) = %.2f", depth_movement + 1.0f);
+	printOverlayLine(3, line);
+}
 
-	setVecValue(up, 0, 0.0f);
-	setVecValue(up, 1, 1.0f);
-	setVecValue(up, 2, 0.0f);
+//Shows the last complete frame's statistics, under printPosition's lines
+void printStatistics(void) {
+	char line[128];
 
-	f_matrix *viewMatrix = lookAt(eye, at, up);
-	f_matrix *translation;
-	
-	const unsigned int surface_width = 3;
-	const unsigned int surface_length = 3;
+	double cpu_time = 0.0;
+	size_t phase;
+	for(phase = 0; phase < PHASE_COUNT; ++phase) {
+		cpu_time += last_stats.phase_time[phase];
+	}
 
-	f_matrix *projectionMatrix = ortho(-1, 1, -1, 1, 0, 2);
+	snprintf(line, sizeof(line), "CPU %.2f ms: math %.3f, upload %.3f, draw %.3f, overlay %.3f, swap %.3f",
+			 cpu_time * 1000.0, last_stats.phase_time[PHASE_MATH] * 1000.0, last_stats.phase_time[PHASE_UPLOAD] * 1000.0,
+			 last_stats.phase_time[PHASE_DRAW] * 1000.0, last_stats.phase_time[PHASE_OVERLAY] * 1000.0, last_stats.phase_time[PHASE_SWAP] * 1000.0);
+	printOverlayLine(5, line);
 
-	size_t c, a;
-	for(a = 0; a < surface_length; ++a) {
-		for(c = 0; c < surface_width; ++c) {
-			translation = translationMatrix(c*surfaceUnitLength - (surface_width * surfaceUnitLength * 0.5f),
-											0.0f,
-											a*surfaceUnitLength - (surface_length * surfaceUnitLength * 0.5f));
-			multMatrix(translation, modelMatrix, DESTRUCTIVE_MULT_A);
-		
-			glUniformMatrix4fv(mModelLoc, 1, GL_FALSE, translation->data);
-			glUniformMatrix4fv(mViewLoc, 1, GL_FALSE, viewMatrix->data);
-			glUniformMatrix4fv(mProjectionLoc, 1, GL_FALSE, projectionMatrix->data);
-
-			//modeLoc true (drawing surfaces)
-			glUniform1i(modeLoc, 1);
-			glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, cube_element_buffer);
-			glDrawElements(GL_TRIANGLE_FAN, 8, GL_UNSIGNED_BYTE, 0);
-			glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, second_cube_element_buffer);
-			glDrawElements(GL_TRIANGLE_FAN, 8, GL_UNSIGNED_BYTE, 0);
-
-			//modeLoc false (drawing lines)
-			f_matrix *scaleLines = scaleMatrix(1.01f);
-			multMatrix(translation, scaleLines, DESTRUCTIVE_MULT_B);
-
-			glUniformMatrix4fv(mModelLoc, 1, GL_FALSE, scaleLines->data);
-
-			glUniform1i(modeLoc, 0);
-			glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, cube_element_buffer);
-			glDrawElements(GL_LINE_LOOP, 8, GL_UNSIGNED_BYTE, 0);
-			glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, second_cube_element_buffer);
-			glDrawElements(GL_LINE_LOOP, 8, GL_UNSIGNED_BYTE, 0);
-
-			destroyMatrix(translation);
-			destroyMatrix(scaleLines);
-		}
+	if(last_stats.gpu_time >= 0.0) {
+		snprintf(line, sizeof(line), "GPU %.2f ms", last_stats.gpu_time * 1000.0);
+	} else {
+		snprintf(line, sizeof(line), "GPU time not available yet");
+	}
+	printOverlayLine(6, line);
+
+	snprintf(line, sizeof(line), "%u draw calls, %u state changes (%u redundant ones filtered), %lu allocations",
+			 last_stats.draw_calls, last_stats.state_changes, last_stats.filtered_state_changes, (unsigned long) last_stats.allocations);
+	printOverlayLine(7, line);
+
+	snprintf(line, sizeof(line), "%u of %u cells drawn, prepared in %.3f ms %s", last_stats.cells_drawn, surface_width * surface_length,
+			 last_stats.prepare_time * 1000.0, pipeline.threaded ? "on the pipeline's thread" : "on the main thread");
+	printOverlayLine(8, line);
+}
+
+/*The visible part of the grid goes out in one instanced draw per part of its mesh, whatever its size*/
+void drawSurface(frame_packet *packet) {
+	GLsizei cell_count = packet->cell_count;
+	current_stats.cells_drawn = packet->cell_count;
+	current_stats.prepare_time = packet->prepare_time;
+
+	uploadCamera(&packet->camera);
+	if(packet->model_count > 0) {
+		uploadSurfaceInstances(packet);
 	}
+	endPhase(PHASE_UPLOAD);
+
+	//Normally all filtered, but it keeps drawSurface independent of whatever was drawn before it
+	stateUseProgram(program);
+	stateBindVertexArray(scene_vertex_array);
+	stateBindBuffer(GL_ELEMENT_ARRAY_BUFFER, surface_element_buffer);
 
-	destroyMatrix(modelMatrix);
-	destroyVec(eye);
-	destroyVec(at);
-	destroyVec(up);
-	destroyMatrix(viewMatrix);
-	destroyMatrix(projectionMatrix);
+	//Triangles are drawn as surfaces (modeLoc true), everything else as outlines (modeLoc false)
+	//The shadowing wrappers drop the uniform changes between consecutive parts of the same kind
+	size_t part;
+	for(part = 0; part < surface_part_count; ++part) {
+		mesh_part const *p = surface_parts + part;
+		int surface = (p->mode >= MESH_TRIANGLES);
+
+		stateUniformMatrix4fv(mLocalLoc, surface ? &surface_local : &outline_local);
+		stateUniform1i(modeLoc, surface);
+		drawElementsInstanced(p->mode, p->count, surface_index_type, p->first * surface_index_size, cell_count);
+	}
+	endPhase(PHASE_DRAW);
 }
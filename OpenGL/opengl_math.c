@@ -2,18 +2,201 @@
 #include <math.h>
 #include <stdio.h>
 #include <string.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdint.h>
 #include "opengl_math.h"
 
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <unistd.h>
+#endif
+
+//-DOPENGL_MATH_NO_SIMD leaves only the scalar kernels, which is what non-x86 and MSVC builds get anyway
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__)) && !defined(OPENGL_MATH_NO_SIMD)
+#define OPENGL_MATH_X86
+#include <immintrin.h>
+#endif
+
+/*Allocation accounting
+ *Every heap allocation the library makes goes through these two, so callers can measure how much a piece of code allocates*/
+static atomic_size_t allocation_count;
+
+static void *mathMalloc(size_t bytes) {
+	atomic_fetch_add_explicit(&allocation_count, 1, memory_order_relaxed);
+	
+	return malloc(bytes);
+}
+
+static void *mathCalloc(size_t count, size_t size) {
+	atomic_fetch_add_explicit(&allocation_count, 1, memory_order_relaxed);
+	
+	return calloc(count, size);
+}
+
+//Heap allocations made by the library since the program started, across all threads
+size_t mathAllocationCount(void) {
+	return atomic_load_explicit(&allocation_count, memory_order_relaxed);
+}
+
+static size_t minSize(size_t a, size_t b) {
+	return a < b ? a : b;
+}
+
+static size_t roundUpSize(size_t a, size_t multiple) {
+	return ((a + multiple - 1)/multiple)*multiple;
+}
+
+/*Arenas
+ *A chain of blocks handed out front to back. Nothing is freed individually - resetArena rewinds every block, keeping the memory for
+ *the next frame, so a steady workload stops touching the heap after its first frame*/
+#define ARENA_ALIGNMENT 16
+
+typedef struct arena_block {
+	struct arena_block *next;
+	size_t size;
+	size_t used;
+	unsigned char *data;
+} arena_block;
+
+struct f_arena {
+	arena_block *first;
+	arena_block *current;
+	size_t block_size;
+};
+
+//Per thread, so a worker building its own frame data doesn't redirect the main thread's allocations
+static _Thread_local f_arena *current_arena = NULL;
+
+static arena_block *createArenaBlock(size_t size) {
+	arena_block *block = mathMalloc(sizeof(arena_block) + size + ARENA_ALIGNMENT);
+	
+	if(block == NULL) {
+		return NULL;
+	}
+	
+	block->next = NULL;
+	block->size = size;
+	block->used = 0;
+	block->data = (unsigned char *) (((uintptr_t) (block + 1) + ARENA_ALIGNMENT - 1) & ~(uintptr_t) (ARENA_ALIGNMENT - 1));
+	
+	return block;
+}
+
+//returns NULL on failure
+f_arena *createArena(size_t bytes) {
+	f_arena *arena = mathMalloc(sizeof(f_arena));
+	
+	if(arena == NULL) {
+		return NULL;
+	}
+	
+	arena->block_size = bytes > 0 ? bytes : 4096;
+	arena->first = createArenaBlock(arena->block_size);
+	arena->current = arena->first;
+	
+	if(arena->first == NULL) {
+		free(arena);
+		
+		return NULL;
+	}
+	
+	return arena;
+}
+
+void resetArena(f_arena *arena) {
+	arena_block *block;
+	for(block = arena->first; block != NULL; block = block->next) {
+		block->used = 0;
+	}
+	
+	arena->current = arena->first;
+}
+
+void destroyArena(f_arena *arena) {
+	if(current_arena == arena) {
+		current_arena = NULL;
+	}
+	
+	arena_block *block = arena->first;
+	while(block != NULL) {
+		arena_block *next = block->next;
+		
+		free(block);
+		block = next;
+	}
+	
+	free(arena);
+}
+
+//Zeroed, like calloc; returns NULL on failure
+void *arenaAlloc(f_arena *arena, size_t bytes) {
+	bytes = roundUpSize(bytes > 0 ? bytes : 1, ARENA_ALIGNMENT);
+	
+	arena_block *block = arena->current;
+	
+	//Blocks past current were only used before the last reset, so they can be reused in order
+	while(block->size - block->used < bytes) {
+		if(block->next == NULL) {
+			arena_block *next = createArenaBlock(bytes > arena->block_size ? bytes : arena->block_size);
+			
+			if(next == NULL) {
+				return NULL;
+			}
+			
+			block->next = next;
+		}
+		
+		block = block->next;
+	}
+	
+	arena->current = block;
+	
+	void *result = block->data + block->used;
+	block->used += bytes;
+	
+	memset(result, 0, bytes);
+	
+	return result;
+}
+
+//returns the arena that was in use until now
+f_arena *useArena(f_arena *arena) {
+	f_arena *previous = current_arena;
+	
+	current_arena = arena;
+	
+	return previous;
+}
+
+//Storage for matrix and vector contents, zeroed, from arena or (when it's NULL) from the heap
+static float *allocFloats(f_arena *arena, size_t count) {
+	if(arena != NULL) {
+		return arenaAlloc(arena, count * sizeof(float));
+	}
+	
+	return mathCalloc(count, sizeof(float));
+}
+
+static void freeFloats(f_arena *arena, float *data) {
+	if(arena == NULL) {
+		free(data);
+	}
+}
+
 f_matrix *createSquareMatrix(size_t size) {
 	return createMatrix(size, size);
 }
 
 f_matrix *createMatrix(size_t rows, size_t columns) {
-	f_matrix *m = malloc(sizeof(f_matrix));
+	f_matrix *m = (current_arena != NULL ? arenaAlloc(current_arena, sizeof(f_matrix)) : mathMalloc(sizeof(f_matrix)));
 
 	m->rows = rows;
 	m->cols = columns;
-	m->data = calloc(rows * columns, sizeof(float));
+	m->data = allocFloats(current_arena, rows * columns);
+	m->arena = current_arena;
+	m->structure = GENERAL_MATRIX;
 	
 	return m;
 }
@@ -22,13 +205,17 @@ f_matrix *copyMatrix(f_matrix *m) {
 	f_matrix *r = createMatrix(m->rows, m->cols);
 	
 	memcpy(r->data, m->data, m->rows * m->cols * sizeof(float));
+	r->structure = m->structure;
 	
 	return r;
 }
 
+//Does nothing for matrices allocated from an arena - they go away when it's reset
 void destroyMatrix(f_matrix *m) {
-	free(m->data);
-	free(m);
+	if(m->arena == NULL) {
+		free(m->data);
+		free(m);
+	}
 }
 
 //Fills as many cells at m[p][p] as possible if m is not a square matrix
@@ -48,87 +235,1718 @@ void makeDiagonal(f_matrix *m, float val) {
 
 void setMatrixValue(f_matrix *m, size_t row, size_t col, float val) {
 	*(m->data + col*m->rows + row) = val;
+	m->structure = GENERAL_MATRIX;
+}
+
+float getMatrixValue(f_matrix *m, size_t row, size_t col) {
+	return *(m->data + col*m->rows + row);
+}
+
+void multMatrixValue(f_matrix *m, size_t row, size_t col, float f) {
+	setMatrixValue(m, row, col, getMatrixValue(m, row, col) * f);
+}
+
+void addMatrixValue(f_matrix *m, size_t row, size_t col, float q) {
+	setMatrixValue(m, row, col, getMatrixValue(m, row, col) + q);
+}
+
+/*4x4 kernels
+ *All of them work on raw column-major 4x4 arrays and accumulate as ((a0*b0 + a1*b1) + a2*b2) + a3*b3, without FMA,
+ *so every variant gives the same floats as the scalar loop (up to the sign of zero)
+ *The SIMD variants are compiled with per-function target attributes and picked at runtime, before main (see selectKernels)*/
+//r may alias a or b, so the product is built up on the side
+static void mult4x4Scalar(float *r, float const *a, float const *b) {
+	float result[16];
+	
+	size_t row, c, i;
+	for(c = 0; c < 4; ++c) {
+		for(row = 0; row < 4; ++row) {
+			float val = 0.0f;
+			
+			for(i = 0; i < 4; ++i) {
+				val += a[i*4 + row] * b[c*4 + i];
+			}
+			
+			result[c*4 + row] = val;
+		}
+	}
+	
+	memcpy(r, result, sizeof(result));
+}
+
+static void mult4x4VecScalar(float *r, float const *m, float const *v) {
+	size_t row, i;
+	for(row = 0; row < 4; ++row) {
+		float val = 0.0f;
+		
+		for(i = 0; i < 4; ++i) {
+			val += m[i*4 + row] * v[i];
+		}
+		
+		r[row] = val;
+	}
+}
+
+//Both a and b affine: b's bottom row is (0, 0, 0, 1), so column c of the result only needs a's first three columns (plus a's
+//last one, for the translation column), and a's bottom row being (0, 0, 0, 1) makes the result's the same
+static void mult4x4AffineScalar(float *r, float const *a, float const *b) {
+	float result[16];
+	
+	size_t row, c, i;
+	for(c = 0; c < 4; ++c) {
+		for(row = 0; row < 3; ++row) {
+			float val = 0.0f;
+			
+			for(i = 0; i < 3; ++i) {
+				val += a[i*4 + row] * b[c*4 + i];
+			}
+			
+			result[c*4 + row] = val;
+		}
+		
+		result[c*4 + 3] = 0.0f;
+	}
+	
+	for(row = 0; row < 3; ++row) {
+		result[12 + row] += a[12 + row];
+	}
+	result[15] = 1.0f;
+	
+	memcpy(r, result, sizeof(result));
+}
+
+#ifdef OPENGL_MATH_X86
+//Column c of the result is the combination of a's columns weighted by column c of b
+__attribute__((target("sse")))
+static void mult4x4SSE(float *r, float const *a, float const *b) {
+	__m128 a0 = _mm_loadu_ps(a);
+	__m128 a1 = _mm_loadu_ps(a + 4);
+	__m128 a2 = _mm_loadu_ps(a + 8);
+	__m128 a3 = _mm_loadu_ps(a + 12);
+	
+	__m128 cols[4];
+	
+	size_t c;
+	for(c = 0; c < 4; ++c) {
+		__m128 col = _mm_mul_ps(a0, _mm_set1_ps(b[c*4]));
+		col = _mm_add_ps(col, _mm_mul_ps(a1, _mm_set1_ps(b[c*4 + 1])));
+		col = _mm_add_ps(col, _mm_mul_ps(a2, _mm_set1_ps(b[c*4 + 2])));
+		col = _mm_add_ps(col, _mm_mul_ps(a3, _mm_set1_ps(b[c*4 + 3])));
+		
+		cols[c] = col;
+	}
+	
+	//Only stored once b has been fully read, so r may alias a or b
+	for(c = 0; c < 4; ++c) {
+		_mm_storeu_ps(r + c*4, cols[c]);
+	}
+}
+
+//Same as mult4x4AffineScalar; the bottom row comes out right on its own, since a's columns end in 0, 0, 0 and 1
+__attribute__((target("sse")))
+static void mult4x4AffineSSE(float *r, float const *a, float const *b) {
+	__m128 a0 = _mm_loadu_ps(a);
+	__m128 a1 = _mm_loadu_ps(a + 4);
+	__m128 a2 = _mm_loadu_ps(a + 8);
+	__m128 a3 = _mm_loadu_ps(a + 12);
+	
+	__m128 cols[4];
+	
+	size_t c;
+	for(c = 0; c < 4; ++c) {
+		__m128 col = _mm_mul_ps(a0, _mm_set1_ps(b[c*4]));
+		col = _mm_add_ps(col, _mm_mul_ps(a1, _mm_set1_ps(b[c*4 + 1])));
+		col = _mm_add_ps(col, _mm_mul_ps(a2, _mm_set1_ps(b[c*4 + 2])));
+		
+		cols[c] = col;
+	}
+	
+	cols[3] = _mm_add_ps(cols[3], a3);
+	
+	for(c = 0; c < 4; ++c) {
+		_mm_storeu_ps(r + c*4, cols[c]);
+	}
+}
+
+__attribute__((target("sse")))
+static void mult4x4VecSSE(float *r, float const *m, float const *v) {
+	__m128 result = _mm_mul_ps(_mm_loadu_ps(m), _mm_set1_ps(v[0]));
+	result = _mm_add_ps(result, _mm_mul_ps(_mm_loadu_ps(m + 4), _mm_set1_ps(v[1])));
+	result = _mm_add_ps(result, _mm_mul_ps(_mm_loadu_ps(m + 8), _mm_set1_ps(v[2])));
+	result = _mm_add_ps(result, _mm_mul_ps(_mm_loadu_ps(m + 12), _mm_set1_ps(v[3])));
+	
+	_mm_storeu_ps(r, result);
+}
+
+//Two result columns per 256 bit register: each 128 bit lane holds one column of b, and
+//_mm256_permute_ps broadcasts an element within its own lane
+__attribute__((target("avx")))
+static void mult4x4AVX(float *r, float const *a, float const *b) {
+	__m256 a0 = _mm256_broadcast_ps((__m128 const *) a);
+	__m256 a1 = _mm256_broadcast_ps((__m128 const *) (a + 4));
+	__m256 a2 = _mm256_broadcast_ps((__m128 const *) (a + 8));
+	__m256 a3 = _mm256_broadcast_ps((__m128 const *) (a + 12));
+	
+	__m256 b01 = _mm256_loadu_ps(b);
+	__m256 b23 = _mm256_loadu_ps(b + 8);
+	
+	__m256 r01 = _mm256_mul_ps(a0, _mm256_permute_ps(b01, 0x00));
+	r01 = _mm256_add_ps(r01, _mm256_mul_ps(a1, _mm256_permute_ps(b01, 0x55)));
+	r01 = _mm256_add_ps(r01, _mm256_mul_ps(a2, _mm256_permute_ps(b01, 0xAA)));
+	r01 = _mm256_add_ps(r01, _mm256_mul_ps(a3, _mm256_permute_ps(b01, 0xFF)));
+	
+	__m256 r23 = _mm256_mul_ps(a0, _mm256_permute_ps(b23, 0x00));
+	r23 = _mm256_add_ps(r23, _mm256_mul_ps(a1, _mm256_permute_ps(b23, 0x55)));
+	r23 = _mm256_add_ps(r23, _mm256_mul_ps(a2, _mm256_permute_ps(b23, 0xAA)));
+	r23 = _mm256_add_ps(r23, _mm256_mul_ps(a3, _mm256_permute_ps(b23, 0xFF)));
+	
+	_mm256_storeu_ps(r, r01);
+	_mm256_storeu_ps(r + 8, r23);
+}
+
+//mult4x4AVX without a's last column, which only column 3 needs - it goes into the upper lane of r23 alone
+__attribute__((target("avx")))
+static void mult4x4AffineAVX(float *r, float const *a, float const *b) {
+	__m256 a0 = _mm256_broadcast_ps((__m128 const *) a);
+	__m256 a1 = _mm256_broadcast_ps((__m128 const *) (a + 4));
+	__m256 a2 = _mm256_broadcast_ps((__m128 const *) (a + 8));
+	__m256 translation = _mm256_insertf128_ps(_mm256_setzero_ps(), _mm_loadu_ps(a + 12), 1);
+	
+	__m256 b01 = _mm256_loadu_ps(b);
+	__m256 b23 = _mm256_loadu_ps(b + 8);
+	
+	__m256 r01 = _mm256_mul_ps(a0, _mm256_permute_ps(b01, 0x00));
+	r01 = _mm256_add_ps(r01, _mm256_mul_ps(a1, _mm256_permute_ps(b01, 0x55)));
+	r01 = _mm256_add_ps(r01, _mm256_mul_ps(a2, _mm256_permute_ps(b01, 0xAA)));
+	
+	__m256 r23 = _mm256_mul_ps(a0, _mm256_permute_ps(b23, 0x00));
+	r23 = _mm256_add_ps(r23, _mm256_mul_ps(a1, _mm256_permute_ps(b23, 0x55)));
+	r23 = _mm256_add_ps(r23, _mm256_mul_ps(a2, _mm256_permute_ps(b23, 0xAA)));
+	r23 = _mm256_add_ps(r23, translation);
+	
+	_mm256_storeu_ps(r, r01);
+	_mm256_storeu_ps(r + 8, r23);
+}
+#endif
+
+/*Column updates
+ *y -= a * x over count floats, the innermost step of small products and of the LU decomposition's unblocked leaves and triangular solves*/
+static void subtractScaledScalar(float *y, float const *x, float a, size_t count) {
+	size_t i;
+	for(i = 0; i < count; ++i) {
+		y[i] -= x[i] * a;
+	}
+}
+
+#ifdef OPENGL_MATH_X86
+__attribute__((target("sse")))
+static void subtractScaledSSE(float *y, float const *x, float a, size_t count) {
+	__m128 scale = _mm_set1_ps(a);
+	
+	size_t i;
+	for(i = 0; i + 4 <= count; i += 4) {
+		_mm_storeu_ps(y + i, _mm_sub_ps(_mm_loadu_ps(y + i), _mm_mul_ps(_mm_loadu_ps(x + i), scale)));
+	}
+	
+	subtractScaledScalar(y + i, x + i, a, count - i);
+}
+
+__attribute__((target("avx")))
+static void subtractScaledAVX(float *y, float const *x, float a, size_t count) {
+	__m256 scale = _mm256_set1_ps(a);
+	
+	size_t i;
+	for(i = 0; i + 8 <= count; i += 8) {
+		_mm256_storeu_ps(y + i, _mm256_sub_ps(_mm256_loadu_ps(y + i), _mm256_mul_ps(_mm256_loadu_ps(x + i), scale)));
+	}
+	
+	subtractScaledScalar(y + i, x + i, a, count - i);
+}
+#endif
+
+static void (*subtractScaled)(float *y, float const *x, float a, size_t count) = subtractScaledScalar;
+
+/*General matrix multiply
+ *C += alpha * A * B for column-major A (m x k), B (k x n) and C (m x n), each with its own leading dimension (distance between columns)
+ *Small products go straight through a column-oriented loop. Larger ones are cut into KC deep slices: for each one, an NC wide panel of B and
+ *an MC tall block of A are packed into contiguous MR/NR wide strips (A's block sized for L2, B's panel for L3), and a register-blocked
+ *MR x NR micro-kernel sweeps over them*/
+#define GEMM_MR 8
+#define GEMM_NR 6
+#define GEMM_MC 128
+#define GEMM_KC 256
+#define GEMM_NC 1020
+#define GEMM_SMALL (48 * 48 * 48)
+
+//Floats of workspace gemm needs - 0 if the product is small enough to skip packing
+static size_t gemmWorkspaceSize(size_t m, size_t n, size_t k) {
+	if(m*n*k <= GEMM_SMALL) {
+		return 0;
+	}
+	
+	size_t kc = minSize(k, GEMM_KC);
+	
+	return roundUpSize(minSize(m, GEMM_MC), GEMM_MR)*kc + kc*roundUpSize(minSize(n, GEMM_NC), GEMM_NR);
+}
+
+static void gemmSmall(size_t m, size_t n, size_t k, float alpha, float const *A, size_t lda, float const *B, size_t ldb, float *C, size_t ldc) {
+	size_t j, p;
+	for(j = 0; j < n; ++j) {
+		float *c = C + j*ldc;
+		
+		for(p = 0; p < k; ++p) {
+			//c - a*(-b) is exactly c + a*b
+			subtractScaled(c, A + p*lda, -(alpha * B[j*ldb + p]), m);
+		}
+	}
+}
+
+//Strips of GEMM_MR rows, each stored k-major, with alpha folded in and the last strip zero padded
+static void packA(size_t mc, size_t kc, float alpha, float const *A, size_t lda, float *packed) {
+	size_t i0, i, p;
+	for(i0 = 0; i0 < mc; i0 += GEMM_MR) {
+		size_t mr = minSize(GEMM_MR, mc - i0);
+		
+		for(p = 0; p < kc; ++p) {
+			float const *a = A + p*lda + i0;
+			
+			for(i = 0; i < mr; ++i) {
+				packed[i] = alpha * a[i];
+			}
+			for(; i < GEMM_MR; ++i) {
+				packed[i] = 0.0f;
+			}
+			
+			packed += GEMM_MR;
+		}
+	}
+}
+
+//Strips of GEMM_NR columns, each stored k-major, with the last strip zero padded
+static void packB(size_t kc, size_t nc, float const *B, size_t ldb, float *packed) {
+	size_t j0, j, p;
+	for(j0 = 0; j0 < nc; j0 += GEMM_NR) {
+		size_t nr = minSize(GEMM_NR, nc - j0);
+		
+		for(j = 0; j < GEMM_NR; ++j) {
+			float const *b = B + (j0 + j)*ldb;
+			
+			for(p = 0; p < kc; ++p) {
+				packed[p*GEMM_NR + j] = (j < nr ? b[p] : 0.0f);
+			}
+		}
+		
+		packed += kc*GEMM_NR;
+	}
+}
+
+//c (an MR x NR tile with leading dimension ldc) += packed a strip * packed b strip
+static void gemmMicroScalar(size_t kc, float const *a, float const *b, float *c, size_t ldc) {
+	float acc[GEMM_NR][GEMM_MR];
+	memset(acc, 0, sizeof(acc));
+	
+	size_t i, j, p;
+	for(p = 0; p < kc; ++p) {
+		for(j = 0; j < GEMM_NR; ++j) {
+			for(i = 0; i < GEMM_MR; ++i) {
+				acc[j][i] += a[i] * b[j];
+			}
+		}
+		
+		a += GEMM_MR;
+		b += GEMM_NR;
+	}
+	
+	for(j = 0; j < GEMM_NR; ++j) {
+		for(i = 0; i < GEMM_MR; ++i) {
+			c[j*ldc + i] += acc[j][i];
+		}
+	}
+}
+
+#ifdef OPENGL_MATH_X86
+__attribute__((target("sse")))
+static void gemmMicroSSE(size_t kc, float const *a, float const *b, float *c, size_t ldc) {
+	__m128 acc[GEMM_NR][2];
+	
+	size_t j, p;
+	for(j = 0; j < GEMM_NR; ++j) {
+		acc[j][0] = _mm_setzero_ps();
+		acc[j][1] = _mm_setzero_ps();
+	}
+	
+	for(p = 0; p < kc; ++p) {
+		__m128 a0 = _mm_loadu_ps(a);
+		__m128 a1 = _mm_loadu_ps(a + 4);
+		
+		for(j = 0; j < GEMM_NR; ++j) {
+			__m128 bj = _mm_set1_ps(b[j]);
+			
+			acc[j][0] = _mm_add_ps(acc[j][0], _mm_mul_ps(a0, bj));
+			acc[j][1] = _mm_add_ps(acc[j][1], _mm_mul_ps(a1, bj));
+		}
+		
+		a += GEMM_MR;
+		b += GEMM_NR;
+	}
+	
+	for(j = 0; j < GEMM_NR; ++j) {
+		float *col = c + j*ldc;
+		
+		_mm_storeu_ps(col, _mm_add_ps(_mm_loadu_ps(col), acc[j][0]));
+		_mm_storeu_ps(col + 4, _mm_add_ps(_mm_loadu_ps(col + 4), acc[j][1]));
+	}
+}
+
+//One 8 wide register per tile column, so the six accumulators, the a strip and a broadcast all stay in registers
+__attribute__((target("avx,fma")))
+static void gemmMicroFMA(size_t kc, float const *a, float const *b, float *c, size_t ldc) {
+	__m256 c0 = _mm256_setzero_ps();
+	__m256 c1 = _mm256_setzero_ps();
+	__m256 c2 = _mm256_setzero_ps();
+	__m256 c3 = _mm256_setzero_ps();
+	__m256 c4 = _mm256_setzero_ps();
+	__m256 c5 = _mm256_setzero_ps();
+	
+	size_t p;
+	for(p = 0; p < kc; ++p) {
+		__m256 av = _mm256_loadu_ps(a);
+		
+		c0 = _mm256_fmadd_ps(av, _mm256_broadcast_ss(b), c0);
+		c1 = _mm256_fmadd_ps(av, _mm256_broadcast_ss(b + 1), c1);
+		c2 = _mm256_fmadd_ps(av, _mm256_broadcast_ss(b + 2), c2);
+		c3 = _mm256_fmadd_ps(av, _mm256_broadcast_ss(b + 3), c3);
+		c4 = _mm256_fmadd_ps(av, _mm256_broadcast_ss(b + 4), c4);
+		c5 = _mm256_fmadd_ps(av, _mm256_broadcast_ss(b + 5), c5);
+		
+		a += GEMM_MR;
+		b += GEMM_NR;
+	}
+	
+	_mm256_storeu_ps(c, _mm256_add_ps(_mm256_loadu_ps(c), c0));
+	_mm256_storeu_ps(c + ldc, _mm256_add_ps(_mm256_loadu_ps(c + ldc), c1));
+	_mm256_storeu_ps(c + 2*ldc, _mm256_add_ps(_mm256_loadu_ps(c + 2*ldc), c2));
+	_mm256_storeu_ps(c + 3*ldc, _mm256_add_ps(_mm256_loadu_ps(c + 3*ldc), c3));
+	_mm256_storeu_ps(c + 4*ldc, _mm256_add_ps(_mm256_loadu_ps(c + 4*ldc), c4));
+	_mm256_storeu_ps(c + 5*ldc, _mm256_add_ps(_mm256_loadu_ps(c + 5*ldc), c5));
+}
+#endif
+
+static void (*gemmMicro)(size_t kc, float const *a, float const *b, float *c, size_t ldc) = gemmMicroScalar;
+
+static void gemmMacro(size_t mc, size_t nc, size_t kc, float const *packedA, float const *packedB, float *C, size_t ldc) {
+	size_t i0, j0, i, j;
+	for(j0 = 0; j0 < nc; j0 += GEMM_NR) {
+		size_t nr = minSize(GEMM_NR, nc - j0);
+		
+		for(i0 = 0; i0 < mc; i0 += GEMM_MR) {
+			size_t mr = minSize(GEMM_MR, mc - i0);
+			float const *a = packedA + i0*kc;
+			float const *b = packedB + j0*kc;
+			float *c = C + j0*ldc + i0;
+			
+			if(mr == GEMM_MR && nr == GEMM_NR) {
+				gemmMicro(kc, a, b, c, ldc);
+			} else {
+				//Edge tiles are computed in full on the side and only their valid part is added to C
+				float tile[GEMM_MR * GEMM_NR];
+				memset(tile, 0, sizeof(tile));
+				
+				gemmMicro(kc, a, b, tile, GEMM_MR);
+				
+				for(j = 0; j < nr; ++j) {
+					for(i = 0; i < mr; ++i) {
+						c[j*ldc + i] += tile[j*GEMM_MR + i];
+					}
+				}
+			}
+		}
+	}
+}
+
+//workspace must hold gemmWorkspaceSize(m, n, k) floats
+static void gemm(size_t m, size_t n, size_t k, float alpha, float const *A, size_t lda, float const *B, size_t ldb, float *C, size_t ldc, float *workspace) {
+	if(m*n*k <= GEMM_SMALL) {
+		gemmSmall(m, n, k, alpha, A, lda, B, ldb, C, ldc);
+		
+		return;
+	}
+	
+	float *packedA = workspace;
+	float *packedB = workspace + roundUpSize(minSize(m, GEMM_MC), GEMM_MR)*minSize(k, GEMM_KC);
+	
+	size_t ic, jc, pc;
+	for(jc = 0; jc < n; jc += GEMM_NC) {
+		size_t nc = minSize(GEMM_NC, n - jc);
+		
+		for(pc = 0; pc < k; pc += GEMM_KC) {
+			size_t kc = minSize(GEMM_KC, k - pc);
+			
+			packB(kc, nc, B + jc*ldb + pc, ldb, packedB);
+			
+			for(ic = 0; ic < m; ic += GEMM_MC) {
+				size_t mc = minSize(GEMM_MC, m - ic);
+				
+				packA(mc, kc, alpha, A + pc*lda + ic, lda, packedA);
+				gemmMacro(mc, nc, kc, packedA, packedB, C + jc*ldc + ic, ldc);
+			}
+		}
+	}
+}
+
+/*Batched point transforms
+ *Points are taken to have w = 1 and m's bottom row is ignored, so every output coordinate is ((m0*x + m1*y) + m2*z) + m3
+ *Every variant adds in that order without FMA, and reads a whole batch before writing it, so outputs may overwrite inputs*/
+static void transformPackedScalar(float const *m, float const *in, float *out, size_t count) {
+	size_t i;
+	for(i = 0; i < count; ++i) {
+		float x = in[i*3];
+		float y = in[i*3 + 1];
+		float z = in[i*3 + 2];
+		
+		out[i*3] = m[0]*x + m[4]*y + m[8]*z + m[12];
+		out[i*3 + 1] = m[1]*x + m[5]*y + m[9]*z + m[13];
+		out[i*3 + 2] = m[2]*x + m[6]*y + m[10]*z + m[14];
+	}
+}
+
+static void transformSoAScalar(float const *m, float const *x, float const *y, float const *z, float *ox, float *oy, float *oz, size_t count) {
+	size_t i;
+	for(i = 0; i < count; ++i) {
+		float px = x[i];
+		float py = y[i];
+		float pz = z[i];
+		
+		ox[i] = m[0]*px + m[4]*py + m[8]*pz + m[12];
+		oy[i] = m[1]*px + m[5]*py + m[9]*pz + m[13];
+		oz[i] = m[2]*px + m[6]*py + m[10]*pz + m[14];
+	}
+}
+
+#ifdef OPENGL_MATH_X86
+//One point per register, built from m's columns; only the xyz lanes are stored so the next point isn't clobbered
+__attribute__((target("sse")))
+static void transformPackedSSE(float const *m, float const *in, float *out, size_t count) {
+	__m128 c0 = _mm_loadu_ps(m);
+	__m128 c1 = _mm_loadu_ps(m + 4);
+	__m128 c2 = _mm_loadu_ps(m + 8);
+	__m128 c3 = _mm_loadu_ps(m + 12);
+	
+	size_t i;
+	for(i = 0; i < count; ++i) {
+		__m128 p = _mm_mul_ps(c0, _mm_set1_ps(in[i*3]));
+		p = _mm_add_ps(p, _mm_mul_ps(c1, _mm_set1_ps(in[i*3 + 1])));
+		p = _mm_add_ps(p, _mm_mul_ps(c2, _mm_set1_ps(in[i*3 + 2])));
+		p = _mm_add_ps(p, c3);
+		
+		_mm_storel_pi((__m64 *) (out + i*3), p);
+		_mm_store_ss(out + i*3 + 2, _mm_movehl_ps(p, p));
+	}
+}
+
+//Four points per register, one register per coordinate
+__attribute__((target("sse")))
+static void transformSoASSE(float const *m, float const *x, float const *y, float const *z, float *ox, float *oy, float *oz, size_t count) {
+	size_t i;
+	for(i = 0; i + 4 <= count; i += 4) {
+		__m128 px = _mm_loadu_ps(x + i);
+		__m128 py = _mm_loadu_ps(y + i);
+		__m128 pz = _mm_loadu_ps(z + i);
+		
+		__m128 rx = _mm_add_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(_mm_set1_ps(m[0]), px), _mm_mul_ps(_mm_set1_ps(m[4]), py)), _mm_mul_ps(_mm_set1_ps(m[8]), pz)), _mm_set1_ps(m[12]));
+		__m128 ry = _mm_add_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(_mm_set1_ps(m[1]), px), _mm_mul_ps(_mm_set1_ps(m[5]), py)), _mm_mul_ps(_mm_set1_ps(m[9]), pz)), _mm_set1_ps(m[13]));
+		__m128 rz = _mm_add_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(_mm_set1_ps(m[2]), px), _mm_mul_ps(_mm_set1_ps(m[6]), py)), _mm_mul_ps(_mm_set1_ps(m[10]), pz)), _mm_set1_ps(m[14]));
+		
+		_mm_storeu_ps(ox + i, rx);
+		_mm_storeu_ps(oy + i, ry);
+		_mm_storeu_ps(oz + i, rz);
+	}
+	
+	transformSoAScalar(m, x + i, y + i, z + i, ox + i, oy + i, oz + i, count - i);
+}
+
+//Eight points per register, one register per coordinate
+__attribute__((target("avx")))
+static void transformSoAAVX(float const *m, float const *x, float const *y, float const *z, float *ox, float *oy, float *oz, size_t count) {
+	size_t i;
+	for(i = 0; i + 8 <= count; i += 8) {
+		__m256 px = _mm256_loadu_ps(x + i);
+		__m256 py = _mm256_loadu_ps(y + i);
+		__m256 pz = _mm256_loadu_ps(z + i);
+		
+		__m256 rx = _mm256_add_ps(_mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(_mm256_set1_ps(m[0]), px), _mm256_mul_ps(_mm256_set1_ps(m[4]), py)), _mm256_mul_ps(_mm256_set1_ps(m[8]), pz)), _mm256_set1_ps(m[12]));
+		__m256 ry = _mm256_add_ps(_mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(_mm256_set1_ps(m[1]), px), _mm256_mul_ps(_mm256_set1_ps(m[5]), py)), _mm256_mul_ps(_mm256_set1_ps(m[9]), pz)), _mm256_set1_ps(m[13]));
+		__m256 rz = _mm256_add_ps(_mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(_mm256_set1_ps(m[2]), px), _mm256_mul_ps(_mm256_set1_ps(m[6]), py)), _mm256_mul_ps(_mm256_set1_ps(m[10]), pz)), _mm256_set1_ps(m[14]));
+		
+		_mm256_storeu_ps(ox + i, rx);
+		_mm256_storeu_ps(oy + i, ry);
+		_mm256_storeu_ps(oz + i, rz);
+	}
+	
+	transformSoAScalar(m, x + i, y + i, z + i, ox + i, oy + i, oz + i, count - i);
+}
+#endif
+
+/*General 4x4 inverse
+ *Both variants return 0, leaving r untouched, when the determinant is 0. They are written for a row-major matrix, which is fine:
+ *the inverse of the transpose is the transpose of the inverse, so fed column-major data they produce column-major data*/
+static int inverse4x4Scalar(float *r, float const *m) {
+	//2x2 determinants of the top two and of the bottom two rows
+	float s0 = m[0]*m[5] - m[4]*m[1];
+	float s1 = m[0]*m[6] - m[4]*m[2];
+	float s2 = m[0]*m[7] - m[4]*m[3];
+	float s3 = m[1]*m[6] - m[5]*m[2];
+	float s4 = m[1]*m[7] - m[5]*m[3];
+	float s5 = m[2]*m[7] - m[6]*m[3];
+	
+	float c0 = m[8]*m[13] - m[12]*m[9];
+	float c1 = m[8]*m[14] - m[12]*m[10];
+	float c2 = m[8]*m[15] - m[12]*m[11];
+	float c3 = m[9]*m[14] - m[13]*m[10];
+	float c4 = m[9]*m[15] - m[13]*m[11];
+	float c5 = m[10]*m[15] - m[14]*m[11];
+	
+	float det = s0*c5 - s1*c4 + s2*c3 + s3*c2 - s4*c1 + s5*c0;
+	if(det == 0.0f) {
+		return 0;
+	}
+	
+	float inverseDet = 1.0f/det;
+	float result[16];
+	
+	result[0] = (m[5]*c5 - m[6]*c4 + m[7]*c3) * inverseDet;
+	result[1] = (-m[1]*c5 + m[2]*c4 - m[3]*c3) * inverseDet;
+	result[2] = (m[13]*s5 - m[14]*s4 + m[15]*s3) * inverseDet;
+	result[3] = (-m[9]*s5 + m[10]*s4 - m[11]*s3) * inverseDet;
+	
+	result[4] = (-m[4]*c5 + m[6]*c2 - m[7]*c1) * inverseDet;
+	result[5] = (m[0]*c5 - m[2]*c2 + m[3]*c1) * inverseDet;
+	result[6] = (-m[12]*s5 + m[14]*s2 - m[15]*s1) * inverseDet;
+	result[7] = (m[8]*s5 - m[10]*s2 + m[11]*s1) * inverseDet;
+	
+	result[8] = (m[4]*c4 - m[5]*c2 + m[7]*c0) * inverseDet;
+	result[9] = (-m[0]*c4 + m[1]*c2 - m[3]*c0) * inverseDet;
+	result[10] = (m[12]*s4 - m[13]*s2 + m[15]*s0) * inverseDet;
+	result[11] = (-m[8]*s4 + m[9]*s2 - m[11]*s0) * inverseDet;
+	
+	result[12] = (-m[4]*c3 + m[5]*c1 - m[6]*c0) * inverseDet;
+	result[13] = (m[0]*c3 - m[1]*c1 + m[2]*c0) * inverseDet;
+	result[14] = (-m[12]*s3 + m[13]*s1 - m[14]*s0) * inverseDet;
+	result[15] = (m[8]*s3 - m[9]*s1 + m[10]*s0) * inverseDet;
+	
+	memcpy(r, result, sizeof(result));
+	
+	return 1;
+}
+
+#ifdef OPENGL_MATH_X86
+/*Block inverse: the matrix is split into the 2x2 blocks A B / C D, each held in one register as (x00, x01, x10, x11), and the
+ *inverse is built from their adjugates (written X#), which for 2x2 matrices are just shuffles and sign flips*/
+#define SHUFFLE(v, w, x, y, z, t) _mm_shuffle_ps(v, w, _MM_SHUFFLE(t, z, y, x))
+#define SWIZZLE(v, x, y, z, t) SHUFFLE(v, v, x, y, z, t)
+
+//a * b for 2x2 blocks
+__attribute__((target("sse")))
+static __m128 mult2x2(__m128 a, __m128 b) {
+	return _mm_add_ps(_mm_mul_ps(a, SWIZZLE(b, 0, 3, 0, 3)), _mm_mul_ps(SWIZZLE(a, 1, 0, 3, 2), SWIZZLE(b, 2, 1, 2, 1)));
+}
+
+//a# * b for 2x2 blocks
+__attribute__((target("sse")))
+static __m128 adjMult2x2(__m128 a, __m128 b) {
+	return _mm_sub_ps(_mm_mul_ps(SWIZZLE(a, 3, 3, 0, 0), b), _mm_mul_ps(SWIZZLE(a, 1, 1, 2, 2), SWIZZLE(b, 2, 3, 0, 1)));
+}
+
+//a * b# for 2x2 blocks
+__attribute__((target("sse")))
+static __m128 multAdj2x2(__m128 a, __m128 b) {
+	return _mm_sub_ps(_mm_mul_ps(a, SWIZZLE(b, 3, 0, 3, 0)), _mm_mul_ps(SWIZZLE(a, 1, 0, 3, 2), SWIZZLE(b, 2, 1, 2, 1)));
+}
+
+__attribute__((target("sse")))
+static int inverse4x4SSE(float *r, float const *m) {
+	__m128 row0 = _mm_loadu_ps(m);
+	__m128 row1 = _mm_loadu_ps(m + 4);
+	__m128 row2 = _mm_loadu_ps(m + 8);
+	__m128 row3 = _mm_loadu_ps(m + 12);
+	
+	__m128 a = _mm_movelh_ps(row0, row1);
+	__m128 b = _mm_movehl_ps(row1, row0);
+	__m128 c = _mm_movelh_ps(row2, row3);
+	__m128 d = _mm_movehl_ps(row3, row2);
+	
+	//(|A|, |B|, |C|, |D|)
+	__m128 dets = _mm_sub_ps(_mm_mul_ps(SHUFFLE(row0, row2, 0, 2, 0, 2), SHUFFLE(row1, row3, 1, 3, 1, 3)),
+							 _mm_mul_ps(SHUFFLE(row0, row2, 1, 3, 1, 3), SHUFFLE(row1, row3, 0, 2, 0, 2)));
+	__m128 detA = SWIZZLE(dets, 0, 0, 0, 0);
+	__m128 detB = SWIZZLE(dets, 1, 1, 1, 1);
+	__m128 detC = SWIZZLE(dets, 2, 2, 2, 2);
+	__m128 detD = SWIZZLE(dets, 3, 3, 3, 3);
+	
+	__m128 dc = adjMult2x2(d, c);
+	__m128 ab = adjMult2x2(a, b);
+	
+	//The adjugates of the inverse's blocks, each still to be divided by |M|
+	__m128 x = _mm_sub_ps(_mm_mul_ps(detD, a), mult2x2(b, dc));
+	__m128 w = _mm_sub_ps(_mm_mul_ps(detA, d), mult2x2(c, ab));
+	__m128 y = _mm_sub_ps(_mm_mul_ps(detB, c), multAdj2x2(d, ab));
+	__m128 z = _mm_sub_ps(_mm_mul_ps(detC, b), multAdj2x2(a, dc));
+	
+	//|M| = |A||D| + |B||C| - tr((A#B)(D#C))
+	__m128 trace = _mm_mul_ps(ab, SWIZZLE(dc, 0, 2, 1, 3));
+	trace = _mm_add_ps(trace, SWIZZLE(trace, 2, 3, 0, 1));
+	trace = _mm_add_ps(trace, SWIZZLE(trace, 1, 0, 3, 2));
+	
+	__m128 det = _mm_sub_ps(_mm_add_ps(_mm_mul_ps(detA, detD), _mm_mul_ps(detB, detC)), trace);
+	if(_mm_cvtss_f32(det) == 0.0f) {
+		return 0;
+	}
+	
+	//Taking the adjugates flips the sign of the off-diagonal elements
+	__m128 inverseDet = _mm_div_ps(_mm_setr_ps(1.0f, -1.0f, -1.0f, 1.0f), det);
+	
+	x = _mm_mul_ps(x, inverseDet);
+	y = _mm_mul_ps(y, inverseDet);
+	z = _mm_mul_ps(z, inverseDet);
+	w = _mm_mul_ps(w, inverseDet);
+	
+	_mm_storeu_ps(r, SHUFFLE(x, y, 3, 1, 3, 1));
+	_mm_storeu_ps(r + 4, SHUFFLE(x, y, 2, 0, 2, 0));
+	_mm_storeu_ps(r + 8, SHUFFLE(z, w, 3, 1, 3, 1));
+	_mm_storeu_ps(r + 12, SHUFFLE(z, w, 2, 0, 2, 0));
+	
+	return 1;
+}
+
+#undef SWIZZLE
+#undef SHUFFLE
+#endif
+
+/*Frustum culling
+ *A box is culled when, for some plane, even its corner furthest along the plane's normal is behind it: with the plane's
+ *(a, b, c, d), that's a*cx + b*cy + c*cz + d + |a|*ex + |b|*ey + |c|*ez < 0. The planes are passed as 6 rows of 4 floats*/
+static size_t cullBoxesScalar(float const *planes, float const *cx, float const *cy, float const *cz, float const *ex, float const *ey, float const *ez,
+							  size_t first, size_t count, unsigned int *visible) {
+	size_t i, visible_count = 0;
+	for(i = first; i < count; ++i) {
+		int inside = 1;
+		
+		size_t p;
+		for(p = 0; p < 6 && inside; ++p) {
+			float const *plane = planes + p*4;
+			
+			float distance = plane[0]*cx[i] + plane[1]*cy[i] + plane[2]*cz[i] + plane[3];
+			float radius = fabsf(plane[0])*ex[i] + fabsf(plane[1])*ey[i] + fabsf(plane[2])*ez[i];
+			
+			inside = distance + radius >= 0.0f;
+		}
+		
+		if(inside) {
+			visible[visible_count++] = i;
+		}
+	}
+	
+	return visible_count;
+}
+
+#ifdef OPENGL_MATH_X86
+/*Four boxes at a time; every candidate index is written, but the output position only advances past visible ones, so there is
+ *no branch per box (visible has room for all of them anyway)*/
+__attribute__((target("sse")))
+static size_t cullBoxesSSE(float const *planes, float const *cx, float const *cy, float const *cz, float const *ex, float const *ey, float const *ez,
+						   size_t first, size_t count, unsigned int *visible) {
+	__m128 const sign = _mm_set1_ps(-0.0f);
+	__m128 const zero = _mm_setzero_ps();
+	
+	size_t i, visible_count = 0;
+	for(i = first; i + 4 <= count; i += 4) {
+		__m128 x = _mm_loadu_ps(cx + i);
+		__m128 y = _mm_loadu_ps(cy + i);
+		__m128 z = _mm_loadu_ps(cz + i);
+		__m128 hx = _mm_loadu_ps(ex + i);
+		__m128 hy = _mm_loadu_ps(ey + i);
+		__m128 hz = _mm_loadu_ps(ez + i);
+		
+		__m128 inside = _mm_cmpeq_ps(zero, zero);
+		
+		size_t p;
+		for(p = 0; p < 6; ++p) {
+			__m128 a = _mm_set1_ps(planes[p*4]);
+			__m128 b = _mm_set1_ps(planes[p*4 + 1]);
+			__m128 c = _mm_set1_ps(planes[p*4 + 2]);
+			
+			__m128 distance = _mm_add_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(a, x), _mm_mul_ps(b, y)), _mm_mul_ps(c, z)), _mm_set1_ps(planes[p*4 + 3]));
+			__m128 radius = _mm_add_ps(_mm_add_ps(_mm_mul_ps(_mm_andnot_ps(sign, a), hx), _mm_mul_ps(_mm_andnot_ps(sign, b), hy)), _mm_mul_ps(_mm_andnot_ps(sign, c), hz));
+			
+			inside = _mm_and_ps(inside, _mm_cmpge_ps(_mm_add_ps(distance, radius), zero));
+		}
+		
+		int mask = _mm_movemask_ps(inside);
+		
+		size_t lane;
+		for(lane = 0; lane < 4; ++lane) {
+			visible[visible_count] = i + lane;
+			visible_count += (mask >> lane) & 1;
+		}
+	}
+	
+	return visible_count + cullBoxesScalar(planes, cx, cy, cz, ex, ey, ez, i, count, visible + visible_count);
+}
+
+//Same as cullBoxesSSE, eight boxes at a time
+__attribute__((target("avx")))
+static size_t cullBoxesAVX(float const *planes, float const *cx, float const *cy, float const *cz, float const *ex, float const *ey, float const *ez,
+						   size_t first, size_t count, unsigned int *visible) {
+	__m256 const sign = _mm256_set1_ps(-0.0f);
+	__m256 const zero = _mm256_setzero_ps();
+	
+	size_t i, visible_count = 0;
+	for(i = first; i + 8 <= count; i += 8) {
+		__m256 x = _mm256_loadu_ps(cx + i);
+		__m256 y = _mm256_loadu_ps(cy + i);
+		__m256 z = _mm256_loadu_ps(cz + i);
+		__m256 hx = _mm256_loadu_ps(ex + i);
+		__m256 hy = _mm256_loadu_ps(ey + i);
+		__m256 hz = _mm256_loadu_ps(ez + i);
+		
+		__m256 inside = _mm256_cmp_ps(zero, zero, _CMP_EQ_OQ);
+		
+		size_t p;
+		for(p = 0; p < 6; ++p) {
+			__m256 a = _mm256_set1_ps(planes[p*4]);
+			__m256 b = _mm256_set1_ps(planes[p*4 + 1]);
+			__m256 c = _mm256_set1_ps(planes[p*4 + 2]);
+			
+			__m256 distance = _mm256_add_ps(_mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(a, x), _mm256_mul_ps(b, y)), _mm256_mul_ps(c, z)), _mm256_set1_ps(planes[p*4 + 3]));
+			__m256 radius = _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(_mm256_andnot_ps(sign, a), hx), _mm256_mul_ps(_mm256_andnot_ps(sign, b), hy)), _mm256_mul_ps(_mm256_andnot_ps(sign, c), hz));
+			
+			inside = _mm256_and_ps(inside, _mm256_cmp_ps(_mm256_add_ps(distance, radius), zero, _CMP_GE_OQ));
+		}
+		
+		int mask = _mm256_movemask_ps(inside);
+		
+		size_t lane;
+		for(lane = 0; lane < 8; ++lane) {
+			visible[visible_count] = i + lane;
+			visible_count += (mask >> lane) & 1;
+		}
+	}
+	
+	return visible_count + cullBoxesScalar(planes, cx, cy, cz, ex, ey, ez, i, count, visible + visible_count);
+}
+#endif
+
+/*Kernel selection
+ *Every pointer starts out at the scalar kernel, and on x86 selectKernels replaces it with the best one the CPU supports before
+ *main runs - so before any thread (the library's pool, or any of the program's own) can be calling through it. Each pointer is
+ *chosen into a local first and stored once*/
+static void (*mult4x4)(float *r, float const *a, float const *b) = mult4x4Scalar;
+static void (*mult4x4Vec)(float *r, float const *m, float const *v) = mult4x4VecScalar;
+static int (*inverse4x4)(float *r, float const *m) = inverse4x4Scalar;
+static void (*mult4x4Affine)(float *r, float const *a, float const *b) = mult4x4AffineScalar;
+static void (*transformPacked)(float const *m, float const *in, float *out, size_t count) = transformPackedScalar;
+static void (*transformSoA)(float const *m, float const *x, float const *y, float const *z, float *ox, float *oy, float *oz, size_t count) = transformSoAScalar;
+static size_t (*cullBoxes)(float const *planes, float const *cx, float const *cy, float const *cz, float const *ex, float const *ey, float const *ez,
+						   size_t first, size_t count, unsigned int *visible) = cullBoxesScalar;
+
+#ifdef OPENGL_MATH_X86
+__attribute__((constructor))
+static void selectKernels(void) {
+	void (*mult)(float *, float const *, float const *) = mult4x4Scalar;
+	void (*mult_vec)(float *, float const *, float const *) = mult4x4VecScalar;
+	int (*inverse)(float *, float const *) = inverse4x4Scalar;
+	void (*mult_affine)(float *, float const *, float const *) = mult4x4AffineScalar;
+	void (*subtract_scaled)(float *, float const *, float, size_t) = subtractScaledScalar;
+	void (*gemm_micro)(size_t, float const *, float const *, float *, size_t) = gemmMicroScalar;
+	void (*transform_packed)(float const *, float const *, float *, size_t) = transformPackedScalar;
+	void (*transform_soa)(float const *, float const *, float const *, float const *, float *, float *, float *, size_t) = transformSoAScalar;
+	size_t (*cull_boxes)(float const *, float const *, float const *, float const *, float const *, float const *, float const *,
+						 size_t, size_t, unsigned int *) = cullBoxesScalar;
+	
+	__builtin_cpu_init();
+	
+	if(__builtin_cpu_supports("sse")) {
+		mult = mult4x4SSE;
+		mult_vec = mult4x4VecSSE;
+		inverse = inverse4x4SSE;
+		mult_affine = mult4x4AffineSSE;
+		subtract_scaled = subtractScaledSSE;
+		gemm_micro = gemmMicroSSE;
+		transform_packed = transformPackedSSE;
+		transform_soa = transformSoASSE;
+		cull_boxes = cullBoxesSSE;
+	}
+	
+	if(__builtin_cpu_supports("avx")) {
+		mult = mult4x4AVX;
+		mult_affine = mult4x4AffineAVX;
+		subtract_scaled = subtractScaledAVX;
+		transform_soa = transformSoAAVX;
+		cull_boxes = cullBoxesAVX;
+	}
+	
+	if(__builtin_cpu_supports("avx") && __builtin_cpu_supports("fma")) {
+		gemm_micro = gemmMicroFMA;
+	}
+	
+	mult4x4 = mult;
+	mult4x4Vec = mult_vec;
+	inverse4x4 = inverse;
+	mult4x4Affine = mult_affine;
+	subtractScaled = subtract_scaled;
+	gemmMicro = gemm_micro;
+	transformPacked = transform_packed;
+	transformSoA = transform_soa;
+	cullBoxes = cull_boxes;
+}
+#endif
+
+/*Structured 4x4 products
+ *Identities are copies and affine pairs skip the bottom row's zeros, but whatever is computed keeps the ((a0*b0 + a1*b1) + a2*b2) + a3*b3
+ *order with the known terms dropped, so results match mult4x4's. Returns the structure of the product*/
+static int isAffineStructure(MATRIX_STRUCTURE s) {
+	return s == TRANSLATION_MATRIX || s == SCALE_MATRIX || s == AFFINE_MATRIX;
+}
+
+static MATRIX_STRUCTURE mult4x4Structured(float *r, float const *a, MATRIX_STRUCTURE sa, float const *b, MATRIX_STRUCTURE sb) {
+	if(sa == IDENTITY_MATRIX) {
+		memmove(r, b, 16 * sizeof(float));
+		
+		return sb;
+	}
+	
+	if(sb == IDENTITY_MATRIX) {
+		memmove(r, a, 16 * sizeof(float));
+		
+		return sa;
+	}
+	
+	if(!isAffineStructure(sa) || !isAffineStructure(sb)) {
+		mult4x4(r, a, b);
+		
+		return GENERAL_MATRIX;
+	}
+	
+	//Translations and scales go through the same kernel too - special-casing them measured slower than the few multiplies it saves
+	mult4x4Affine(r, a, b);
+	
+	if(sa == sb) {
+		return sa;
+	}
+	
+	return AFFINE_MATRIX;
+}
+
+//Returns NULL on failure
+//PURE_MULT -> Preserves both arguments, returns a newly allocated matrix (with createMatrix)
+//DESTRUCTIVE_MULT_B -> If successful, destructively alters the right side matrix/the second argument, with the return value being the pointer passed in the 2nd arg
+//result is a * b
+//invalidates references to b->data when in DESTRUCTIVE_MULT mode (only 4x4 products are written in place)
+//DESTRUCTIVE_MULT_A -> same as B, but for the first matrix
+f_matrix *multMatrix(f_matrix *a, f_matrix *b, MULT_MODE mode) {
+	if(a->cols != b->rows) {
+		return NULL;
+	}
+	
+	f_matrix *m;
+	
+	switch(mode) {
+		case PURE_MULT:
+			m = createMatrix(a->rows, b->cols);
+			
+			if(multMatrixInto(m, a, b, NULL) == NULL) {
+				destroyMatrix(m);
+				
+				return NULL;
+			}
+			
+			return m;
+		case DESTRUCTIVE_MULT_A:
+			m = a;
+			
+			break;
+		case DESTRUCTIVE_MULT_B:
+			m = b;
+			
+			break;
+		default:
+			return NULL;
+	}
+	
+	if(a->rows == 4 && a->cols == 4 && b->cols == 4) {
+		m->structure = mult4x4Structured(m->data, a->data, a->structure, b->data, b->structure);
+		
+		return m;
+	}
+	
+	//The operand being overwritten is still being read, so the product goes into new storage (from the same place) that then replaces its data
+	f_matrix result;
+	result.rows = a->rows;
+	result.cols = b->cols;
+	result.data = allocFloats(m->arena, result.rows * result.cols);
+	result.arena = NULL;
+	result.structure = GENERAL_MATRIX;
+	
+	if(result.data == NULL || multMatrixInto(&result, a, b, NULL) == NULL) {
+		freeFloats(m->arena, result.data);
+		
+		return NULL;
+	}
+	
+	freeFloats(m->arena, m->data);
+	m->rows = result.rows;
+	m->cols = result.cols;
+	m->data = result.data;
+	m->structure = GENERAL_MATRIX;
+	
+	return m;
+}
+
+size_t multMatrixWorkspaceSize(f_matrix *a, f_matrix *b) {
+	return gemmWorkspaceSize(a->rows, b->cols, a->cols);
+}
+
+//Returns NULL on failure
+//result must already be a->rows x b->cols and must not share data with a or b
+//workspace must hold multMatrixWorkspaceSize(a, b) floats, or be NULL to have it allocated and freed here
+f_matrix *multMatrixInto(f_matrix *result, f_matrix *a, f_matrix *b, float *workspace) {
+	if(a->cols != b->rows || result->rows != a->rows || result->cols != b->cols) {
+		return NULL;
+	}
+	
+	if(a->rows == 4 && a->cols == 4 && b->cols == 4) {
+		result->structure = mult4x4Structured(result->data, a->data, a->structure, b->data, b->structure);
+		
+		return result;
+	}
+	
+	size_t workspace_size = multMatrixWorkspaceSize(a, b);
+	float *allocated = NULL;
+	
+	if(workspace == NULL && workspace_size > 0) {
+		allocated = mathMalloc(workspace_size * sizeof(float));
+		
+		if(allocated == NULL) {
+			return NULL;
+		}
+		
+		workspace = allocated;
+	}
+	
+	result->structure = GENERAL_MATRIX;
+	memset(result->data, 0, result->rows * result->cols * sizeof(float));
+	gemm(a->rows, b->cols, a->cols, 1.0f, a->data, a->rows, b->data, b->rows, result->data, result->rows, workspace);
+	
+	free(allocated);
+	
+	return result;
+}
+
+/*Thread pool
+ *One library-wide set of workers, created once and reused. A job is a number of independent tasks that the workers and the
+ *calling thread pull off a shared atomic counter - the mutex is only taken to start and finish a job, never per task*/
+typedef void (*pool_job)(void *ctx, size_t task, size_t thread);
+
+typedef struct {
+	pthread_t *threads;
+	size_t workers;
+	
+	pthread_mutex_t dispatch;	//serialises callers, so only one job runs at a time
+	pthread_mutex_t lock;
+	pthread_cond_t job_ready;
+	pthread_cond_t job_done;
+	
+	unsigned long generation;
+	int shutdown;
+	size_t active;
+	
+	pool_job job;
+	void *ctx;
+	size_t task_count;
+	atomic_size_t next_task;
+} math_thread_pool;
+
+static math_thread_pool pool = {.dispatch = PTHREAD_MUTEX_INITIALIZER, .lock = PTHREAD_MUTEX_INITIALIZER,
+								.job_ready = PTHREAD_COND_INITIALIZER, .job_done = PTHREAD_COND_INITIALIZER};
+
+static void runPoolTasks(size_t thread) {
+	size_t task;
+	while((task = atomic_fetch_add(&pool.next_task, 1)) < pool.task_count) {
+		pool.job(pool.ctx, task, thread);
+	}
+}
+
+static void *poolWorker(void *arg) {
+	size_t thread = (size_t) (uintptr_t) arg;
+	
+	unsigned long seen = 0;
+	
+	for(;;) {
+		pthread_mutex_lock(&pool.lock);
+		
+		while(!pool.shutdown && pool.generation == seen) {
+			pthread_cond_wait(&pool.job_ready, &pool.lock);
+		}
+		
+		if(pool.shutdown) {
+			pthread_mutex_unlock(&pool.lock);
+			
+			return NULL;
+		}
+		
+		seen = pool.generation;
+		pthread_mutex_unlock(&pool.lock);
+		
+		runPoolTasks(thread);
+		
+		pthread_mutex_lock(&pool.lock);
+		if(--pool.active == 0) {
+			pthread_cond_signal(&pool.job_done);
+		}
+		pthread_mutex_unlock(&pool.lock);
+	}
+}
+
+//Runs job(ctx, task, thread) for every task in [0, task_count), with thread in [0, mathThreadPoolSize() + 1)
+//Thread 0 is always the caller, which also covers the case of there being no pool
+static void runParallel(pool_job job, void *ctx, size_t task_count) {
+	pthread_mutex_lock(&pool.dispatch);
+	
+	pool.job = job;
+	pool.ctx = ctx;
+	pool.task_count = task_count;
+	atomic_store(&pool.next_task, 0);
+	
+	if(pool.workers > 0) {
+		pthread_mutex_lock(&pool.lock);
+		pool.active = pool.workers;
+		++pool.generation;
+		pthread_cond_broadcast(&pool.job_ready);
+		pthread_mutex_unlock(&pool.lock);
+	}
+	
+	runPoolTasks(0);
+	
+	if(pool.workers > 0) {
+		pthread_mutex_lock(&pool.lock);
+		while(pool.active > 0) {
+			pthread_cond_wait(&pool.job_done, &pool.lock);
+		}
+		pthread_mutex_unlock(&pool.lock);
+	}
+	
+	pthread_mutex_unlock(&pool.dispatch);
+}
+
+static size_t onlineProcessors(void) {
+#ifdef _WIN32
+	SYSTEM_INFO info;
+	GetSystemInfo(&info);
+	
+	return info.dwNumberOfProcessors;
+#else
+	long count = sysconf(_SC_NPROCESSORS_ONLN);
+	
+	return count > 0 ? (size_t) count : 1;
+#endif
+}
+
+//workers == 0 -> one worker per online processor, besides the calling thread
+//returns 0 on failure, or if there already is a pool
+int createMathThreadPool(size_t workers) {
+	if(pool.threads != NULL) {
+		return 0;
+	}
+	
+	if(workers == 0) {
+		workers = onlineProcessors() - 1;
+		
+		if(workers == 0) {
+			return 1;
+		}
+	}
+	
+	pool.threads = mathMalloc(workers * sizeof(pthread_t));
+	if(pool.threads == NULL) {
+		return 0;
+	}
+	
+	//Workers start out having seen generation 0, so a pool created after an earlier one was destroyed has to start there too
+	pool.generation = 0;
+	pool.shutdown = 0;
+	pool.active = 0;
+	
+	size_t i;
+	for(i = 0; i < workers; ++i) {
+		if(pthread_create(pool.threads + i, NULL, poolWorker, (void *) (uintptr_t) (i + 1)) != 0) {
+			pool.workers = i;
+			destroyMathThreadPool();
+			
+			return 0;
+		}
+	}
+	
+	pool.workers = workers;
+	
+	return 1;
+}
+
+void destroyMathThreadPool(void) {
+	if(pool.threads == NULL) {
+		return;
+	}
+	
+	pthread_mutex_lock(&pool.dispatch);
+	
+	pthread_mutex_lock(&pool.lock);
+	pool.shutdown = 1;
+	pthread_cond_broadcast(&pool.job_ready);
+	pthread_mutex_unlock(&pool.lock);
+	
+	size_t i;
+	for(i = 0; i < pool.workers; ++i) {
+		pthread_join(pool.threads[i], NULL);
+	}
+	
+	free(pool.threads);
+	pool.threads = NULL;
+	pool.workers = 0;
+	
+	pthread_mutex_unlock(&pool.dispatch);
+}
+
+size_t mathThreadPoolSize(void) {
+	return pool.workers;
+}
+
+/*Parallel multiply
+ *The output is cut into a grid of tiles - whole micro-kernel strips, at least GEMM_MC x GEMM_NR - and every tile is an independent gemm
+ *with its own workspace, so the only shared state is the task counter*/
+typedef struct {
+	float const *A;
+	float const *B;
+	float *C;
+	size_t lda, ldb, ldc;
+	float alpha;
+	size_t m, n, k;
+	size_t tile_rows, tile_cols;
+	size_t row_tiles;
+	float **workspaces;
+} parallel_gemm;
+
+static void parallelGemmTask(void *ctx, size_t task, size_t thread) {
+	parallel_gemm *job = ctx;
+	
+	size_t i0 = (task % job->row_tiles) * job->tile_rows;
+	size_t j0 = (task / job->row_tiles) * job->tile_cols;
+	size_t mc = minSize(job->tile_rows, job->m - i0);
+	size_t nc = minSize(job->tile_cols, job->n - j0);
+	
+	gemm(mc, nc, job->k, job->alpha, job->A + i0, job->lda, job->B + j0*job->ldb, job->ldb, job->C + j0*job->ldc + i0, job->ldc, job->workspaces[thread]);
+}
+
+//C += alpha * A * B with gemm's arguments, splitting C across the pool; returns 0 on allocation failure, with C untouched
+static int gemmAccumulateParallel(size_t m, size_t n, size_t k, float alpha, float const *A, size_t lda, float const *B, size_t ldb, float *C, size_t ldc) {
+	size_t threads = pool.workers + 1;
+	
+	//Aim for a few tiles per thread so uneven edges still balance out; columns are split first since they share nothing in C
+	size_t tiles_wanted = threads * 4;
+	size_t tile_cols = roundUpSize((n + tiles_wanted - 1)/tiles_wanted, GEMM_NR);
+	size_t col_tiles = (n + tile_cols - 1)/tile_cols;
+	size_t row_tiles = (tiles_wanted + col_tiles - 1)/col_tiles;
+	size_t tile_rows = roundUpSize((m + row_tiles - 1)/row_tiles, GEMM_MR);
+	
+	if(tile_rows < GEMM_MC && m > GEMM_MC) {
+		tile_rows = GEMM_MC;
+	}
+	row_tiles = (m + tile_rows - 1)/tile_rows;
+	
+	parallel_gemm job;
+	job.A = A;
+	job.B = B;
+	job.C = C;
+	job.lda = lda;
+	job.ldb = ldb;
+	job.ldc = ldc;
+	job.alpha = alpha;
+	job.m = m;
+	job.n = n;
+	job.k = k;
+	job.tile_rows = tile_rows;
+	job.tile_cols = tile_cols;
+	job.row_tiles = row_tiles;
+	
+	size_t workspace_size = gemmWorkspaceSize(tile_rows, tile_cols, k);
+	job.workspaces = mathCalloc(threads, sizeof(float *));
+	float *workspace = mathMalloc((workspace_size > 0 ? workspace_size : 1) * threads * sizeof(float));
+	
+	if(job.workspaces == NULL || workspace == NULL) {
+		free(job.workspaces);
+		free(workspace);
+		
+		return 0;
+	}
+	
+	size_t t;
+	for(t = 0; t < threads; ++t) {
+		job.workspaces[t] = workspace + t*workspace_size;
+	}
+	
+	runParallel(parallelGemmTask, &job, row_tiles * col_tiles);
+	
+	free(workspace);
+	free(job.workspaces);
+	
+	return 1;
+}
+
+//C = A * B for tightly packed operands, splitting C across the pool; returns 0 on allocation failure
+static int gemmParallel(size_t m, size_t n, size_t k, float const *A, float const *B, float *C) {
+	memset(C, 0, m * n * sizeof(float));
+	
+	return gemmAccumulateParallel(m, n, k, 1.0f, A, m, B, k, C, m);
+}
+
+//Same contract as multMatrix
+//Only products of at least PARALLEL_MULT_THRESHOLD multiply-adds are split across the pool - anything smaller, 4x4 included,
+//goes straight to multMatrix without touching another thread
+f_matrix *multMatrixParallel(f_matrix *a, f_matrix *b, MULT_MODE mode) {
+	if(a->cols != b->rows) {
+		return NULL;
+	}
+	
+	if(pool.workers == 0 || a->rows * b->cols * a->cols < PARALLEL_MULT_THRESHOLD) {
+		return multMatrix(a, b, mode);
+	}
+	
+	f_matrix *m;
+	
+	switch(mode) {
+		case PURE_MULT:
+			m = createMatrix(a->rows, b->cols);
+			
+			if(!gemmParallel(a->rows, b->cols, a->cols, a->data, b->data, m->data)) {
+				destroyMatrix(m);
+				
+				return NULL;
+			}
+			
+			return m;
+		case DESTRUCTIVE_MULT_A:
+			m = a;
+			
+			break;
+		case DESTRUCTIVE_MULT_B:
+			m = b;
+			
+			break;
+		default:
+			return NULL;
+	}
+	
+	float *data = allocFloats(m->arena, a->rows * b->cols);
+	
+	if(data == NULL || !gemmParallel(a->rows, b->cols, a->cols, a->data, b->data, data)) {
+		freeFloats(m->arena, data);
+		
+		return NULL;
+	}
+	
+	freeFloats(m->arena, m->data);
+	m->rows = a->rows;
+	m->cols = b->cols;
+	m->data = data;
+	m->structure = GENERAL_MATRIX;
+	
+	return m;
+}
+
+/*LU decomposition
+ *Recursive over columns: the left half of a panel is factored first, its row swaps and L are applied to the right half (a triangular solve),
+ *the rest of the right half is updated with a single gemm and is then factored in turn. Nearly all the work ends up in a few large gemm
+ *calls, which go across the thread pool past PARALLEL_MULT_THRESHOLD, while row swaps and the smallest triangular solves are split
+ *across it by columns*/
+#define LU_LEAF 16				//panels this narrow are factored a column at a time
+#define TRSM_LEAF 32			//triangular solves this small are plain substitution
+#define COLUMN_PARALLEL_WORK (1 << 16)	//element updates below which column jobs stay on the calling thread
+
+//Works on columns [first, last) of whatever ctx describes
+typedef void (*column_job)(void *ctx, size_t first, size_t last);
+
+typedef struct {
+	column_job job;
+	void *ctx;
+	size_t cols;
+	size_t chunk;
+} column_chunks;
+
+static void columnChunkTask(void *ctx, size_t task, size_t thread) {
+	column_chunks *chunks = ctx;
+	(void) thread;
+	
+	size_t first = task * chunks->chunk;
+	
+	chunks->job(chunks->ctx, first, minSize(first + chunks->chunk, chunks->cols));
+}
+
+static void runOverColumns(column_job job, void *ctx, size_t cols, size_t work_per_column) {
+	if(pool.workers == 0 || cols < 2 || cols * work_per_column < COLUMN_PARALLEL_WORK) {
+		job(ctx, 0, cols);
+		
+		return;
+	}
+	
+	size_t tasks_wanted = (pool.workers + 1) * 4;
+	
+	column_chunks chunks;
+	chunks.job = job;
+	chunks.ctx = ctx;
+	chunks.cols = cols;
+	chunks.chunk = (cols + tasks_wanted - 1)/tasks_wanted;
+	
+	runParallel(columnChunkTask, &chunks, (cols + chunks.chunk - 1)/chunks.chunk);
+}
+
+//C += alpha * A * B, across the pool when it's big enough and there's memory for it
+static void gemmUpdate(size_t m, size_t n, size_t k, float alpha, float const *A, size_t lda, float const *B, size_t ldb, float *C, size_t ldc, float *workspace) {
+	if(pool.workers > 0 && m*n*k >= PARALLEL_MULT_THRESHOLD && gemmAccumulateParallel(m, n, k, alpha, A, lda, B, ldb, C, ldc)) {
+		return;
+	}
+	
+	gemm(m, n, k, alpha, A, lda, B, ldb, C, ldc, workspace);
+}
+
+typedef struct {
+	float *A;
+	size_t lda;
+	size_t const *pivots;
+	size_t count;
+} row_swaps;
+
+static void swapRowsOfColumns(void *ctx, size_t first, size_t last) {
+	row_swaps *swaps = ctx;
+	
+	size_t i, j;
+	for(j = first; j < last; ++j) {
+		float *a = swaps->A + j*swaps->lda;
+		
+		for(i = 0; i < swaps->count; ++i) {
+			size_t p = swaps->pivots[i];
+			float t = a[i];
+			
+			a[i] = a[p];
+			a[p] = t;
+		}
+	}
+}
+
+//Swaps row i with row pivots[i], for i from 0 to count, in cols columns starting at A
+static void applyRowSwaps(float *A, size_t lda, size_t cols, size_t const *pivots, size_t count) {
+	row_swaps swaps = {A, lda, pivots, count};
+	
+	runOverColumns(swapRowsOfColumns, &swaps, cols, count);
+}
+
+//n x n triangle T and the n rows of B it's solved against
+typedef struct {
+	size_t n;
+	float const *T;
+	size_t ldt;
+	float *B;
+	size_t ldb;
+} triangular_solve;
+
+static void lowerUnitSolveColumns(void *ctx, size_t first, size_t last) {
+	triangular_solve *solve = ctx;
+	
+	size_t j, p;
+	for(j = first; j < last; ++j) {
+		float *b = solve->B + j*solve->ldb;
+		
+		for(p = 0; p < solve->n; ++p) {
+			subtractScaled(b + p + 1, solve->T + p*solve->ldt + p + 1, b[p], solve->n - p - 1);
+		}
+	}
+}
+
+static void upperSolveColumns(void *ctx, size_t first, size_t last) {
+	triangular_solve *solve = ctx;
+	
+	size_t j, p;
+	for(j = first; j < last; ++j) {
+		float *b = solve->B + j*solve->ldb;
+		
+		for(p = solve->n; p-- > 0;) {
+			float const *u = solve->T + p*solve->ldt;
+			
+			b[p] /= u[p];
+			subtractScaled(b, u, b[p], p);
+		}
+	}
+}
+
+//B (n x k) = L^-1 * B, for the unit lower triangle of L - what's above its diagonal, and the diagonal itself, is never read
+static void solveLowerUnit(size_t n, size_t k, float const *L, size_t ldl, float *B, size_t ldb, float *workspace) {
+	if(n <= TRSM_LEAF) {
+		triangular_solve solve = {n, L, ldl, B, ldb};
+		
+		runOverColumns(lowerUnitSolveColumns, &solve, k, n*n/2);
+		
+		return;
+	}
+	
+	size_t n1 = n/2;
+	
+	solveLowerUnit(n1, k, L, ldl, B, ldb, workspace);
+	gemmUpdate(n - n1, k, n1, -1.0f, L + n1, ldl, B, ldb, B + n1, ldb, workspace);
+	solveLowerUnit(n - n1, k, L + n1*ldl + n1, ldl, B + n1, ldb, workspace);
+}
+
+//B (n x k) = U^-1 * B, for the upper triangle of U - what's below its diagonal is never read
+static void solveUpper(size_t n, size_t k, float const *U, size_t ldu, float *B, size_t ldb, float *workspace) {
+	if(n <= TRSM_LEAF) {
+		triangular_solve solve = {n, U, ldu, B, ldb};
+		
+		runOverColumns(upperSolveColumns, &solve, k, n*n/2);
+		
+		return;
+	}
+	
+	size_t n1 = n/2;
+	
+	solveUpper(n - n1, k, U + n1*ldu + n1, ldu, B + n1, ldb, workspace);
+	gemmUpdate(n1, k, n - n1, -1.0f, U + n1*ldu, ldu, B + n1, ldb, B, ldb, workspace);
+	solveUpper(n1, k, U, ldu, B, ldb, workspace);
+}
+
+//Unblocked, for an m x n panel (m >= n) narrow enough to stay in cache; a zero pivot column is left as it is
+static void luLeaf(float *A, size_t lda, size_t m, size_t n, size_t *pivots) {
+	size_t i, j, c;
+	for(j = 0; j < n; ++j) {
+		float *column = A + j*lda;
+		
+		size_t p = j;
+		float largest = fabsf(column[j]);
+		
+		for(i = j + 1; i < m; ++i) {
+			if(fabsf(column[i]) > largest) {
+				largest = fabsf(column[i]);
+				p = i;
+			}
+		}
+		
+		pivots[j] = p;
+		
+		if(p != j) {
+			for(c = 0; c < n; ++c) {
+				float t = A[c*lda + j];
+				
+				A[c*lda + j] = A[c*lda + p];
+				A[c*lda + p] = t;
+			}
+		}
+		
+		if(column[j] != 0.0f) {
+			float reciprocal = 1.0f / column[j];
+			
+			for(i = j + 1; i < m; ++i) {
+				column[i] *= reciprocal;
+			}
+		}
+		
+		for(c = j + 1; c < n; ++c) {
+			subtractScaled(A + c*lda + j + 1, column + j + 1, A[c*lda + j], m - j - 1);
+		}
+	}
+}
+
+//Factors the m x n panel at A (m >= n) in place, with pivots relative to its first row
+static void luRecursive(float *A, size_t lda, size_t m, size_t n, size_t *pivots, float *workspace) {
+	if(n <= LU_LEAF) {
+		luLeaf(A, lda, m, n, pivots);
+		
+		return;
+	}
+	
+	size_t n1 = n/2;
+	size_t n2 = n - n1;
+	float *A12 = A + n1*lda;
+	float *A21 = A + n1;
+	float *A22 = A12 + n1;
+	
+	luRecursive(A, lda, m, n1, pivots, workspace);
+	
+	applyRowSwaps(A12, lda, n2, pivots, n1);
+	solveLowerUnit(n1, n2, A, lda, A12, lda, workspace);
+	gemmUpdate(m - n1, n2, n1, -1.0f, A21, lda, A12, lda, A22, lda, workspace);
+	
+	luRecursive(A22, lda, m - n1, n2, pivots + n1, workspace);
+	
+	//The right half's swaps still have to reach the rows of L left of it
+	applyRowSwaps(A21, lda, n1, pivots + n1, n2);
+	
+	size_t i;
+	for(i = n1; i < n; ++i) {
+		pivots[i] += n1;
+	}
+}
+
+//Floats of workspace the serial gemm calls under an LU of order n, solved against k columns, can need
+static size_t luWorkspaceSize(size_t n, size_t k) {
+	size_t size = gemmWorkspaceSize(n, (k > n ? k : n), n);
+	
+	return (size > 0 ? size : 1);
+}
+
+f_lu *createLU(f_matrix *m) {
+	if(m->rows != m->cols) {
+		return NULL;
+	}
+	
+	size_t n = m->rows;
+	
+	f_lu *lu = mathMalloc(sizeof(f_lu));
+	size_t *pivots = mathMalloc((n > 0 ? n : 1) * sizeof(size_t));
+	float *workspace = mathMalloc(luWorkspaceSize(n, n) * sizeof(float));
+	
+	if(lu == NULL || pivots == NULL || workspace == NULL) {
+		free(lu);
+		free(pivots);
+		free(workspace);
+		
+		return NULL;
+	}
+	
+	lu->lu = copyMatrix(m);
+	lu->lu->structure = GENERAL_MATRIX;
+	lu->pivots = pivots;
+	
+	luRecursive(lu->lu->data, n, n, n, pivots, workspace);
+	
+	free(workspace);
+	
+	lu->sign = 1;
+	
+	size_t i;
+	for(i = 0; i < n; ++i) {
+		if(pivots[i] != i) {
+			lu->sign = -lu->sign;
+		}
+	}
+	
+	return lu;
+}
+
+void destroyLU(f_lu *lu) {
+	destroyMatrix(lu->lu);
+	free(lu->pivots);
+	free(lu);
+}
+
+int isSingularLU(f_lu *lu) {
+	size_t n = lu->lu->rows;
+	
+	size_t i;
+	for(i = 0; i < n; ++i) {
+		if(lu->lu->data[i*n + i] == 0.0f) {
+			return 1;
+		}
+	}
+	
+	return 0;
 }
 
-float getMatrixValue(f_matrix *m, size_t row, size_t col) {
-	return *(m->data + col*m->rows + row);
+int solveLU(f_lu *lu, f_matrix *b) {
+	size_t n = lu->lu->rows;
+	
+	if(b->rows != n || isSingularLU(lu)) {
+		return 0;
+	}
+	
+	float *workspace = mathMalloc(luWorkspaceSize(n, b->cols) * sizeof(float));
+	
+	if(workspace == NULL) {
+		return 0;
+	}
+	
+	applyRowSwaps(b->data, n, b->cols, lu->pivots, n);
+	solveLowerUnit(n, b->cols, lu->lu->data, n, b->data, n, workspace);
+	solveUpper(n, b->cols, lu->lu->data, n, b->data, n, workspace);
+	
+	free(workspace);
+	
+	b->structure = GENERAL_MATRIX;
+	
+	return 1;
 }
 
-void multMatrixValue(f_matrix *m, size_t row, size_t col, float f) {
-	setMatrixValue(m, row, col, getMatrixValue(m, row, col) * f);
+float determinantLU(f_lu *lu) {
+	size_t n = lu->lu->rows;
+	double determinant = lu->sign;
+	
+	size_t i;
+	for(i = 0; i < n; ++i) {
+		determinant *= lu->lu->data[i*n + i];
+	}
+	
+	return (float) determinant;
 }
 
-void addMatrixValue(f_matrix *m, size_t row, size_t col, float q) {
-	setMatrixValue(m, row, col, getMatrixValue(m, row, col) + q);
+f_matrix *solveMatrix(f_matrix *a, f_matrix *b) {
+	if(a->rows != b->rows) {
+		return NULL;
+	}
+	
+	f_lu *lu = createLU(a);
+	
+	if(lu == NULL) {
+		return NULL;
+	}
+	
+	f_matrix *x = copyMatrix(b);
+	
+	if(!solveLU(lu, x)) {
+		destroyMatrix(x);
+		x = NULL;
+	}
+	
+	destroyLU(lu);
+	
+	return x;
 }
 
-//Returns NULL on failure
-//PURE_MULT -> Preserves both arguments, returns a newly allocated matrix (with createMatrix)
-//DESTRUCTIVE_MULT_B -> If successful, destructively alters the right side matrix/the second argument, with the return value being the pointer passed in the 2nd arg
-//result is a * b
-//invalidates references to b->data when in DESTRUCTIVE_MULT mode (actually, no it doesn't, since it uses realloc, but it's safer to assume so)
-//DESTRUCTIVE_MULT_A -> same as B, but for the first matrix
-f_matrix *multMatrix(f_matrix *a, f_matrix *b, MULT_MODE mode) {
-	if(a->cols != b->rows) {
+f_matrix *inverseMatrix(f_matrix *m) {
+	f_lu *lu = createLU(m);
+	
+	if(lu == NULL) {
 		return NULL;
 	}
 	
-	float data[a->rows*b->cols];
-	f_matrix result;
-	result.rows = a->rows;
-	result.cols = b->cols;
-	result.data = data;
+	f_matrix *inverse = createSquareMatrix(m->rows);
+	makeIdentity(inverse);
 	
-	size_t a_r, b_c, i, shared_dim = a->cols;
-	for(a_r = 0; a_r < a->rows; ++a_r) {
-		for(b_c = 0; b_c < b->cols; ++b_c) {
-			float val = 0.0f;
-			
-			for(i = 0; i < shared_dim; ++i) {
-				float v1 = getMatrixValue(a, a_r, i);
-				float v2 = getMatrixValue(b, i, b_c);
-				
-				val += (v1 * v2);
-			}
-			
-			setMatrixValue(&result, a_r, b_c, val);
-		}
+	if(!solveLU(lu, inverse)) {
+		destroyMatrix(inverse);
+		inverse = NULL;
 	}
+	
+	destroyLU(lu);
+	
+	return inverse;
+}
 
-	f_matrix *m;
-		
-	switch(mode) {
-		case PURE_MULT:
-			m = createMatrix(a->rows, b->cols);
-			
-			break;
-		case DESTRUCTIVE_MULT_A:
-			if(a->cols != b->cols) { //|| a->rows != a->rows
-				a->cols = b->cols;
-				a->data = realloc(a->data, a->rows * a->cols * sizeof(float));
-			}
-			
-			m = a;
-			
-			break;
-		case DESTRUCTIVE_MULT_B:
-			if(b->rows != a->rows) { //|| b->cols != b->cols
-				b->rows = a->rows;
-				//free(b->data);
-				//b->data = malloc(b->rows * b->cols * sizeof(float));
-				
-				b->data = realloc(b->data, b->rows * b->cols * sizeof(float));
-			}
-			
-			m = b;
-			
-			break;
-		default:
-			return NULL;
+float matrixDeterminant(f_matrix *m) {
+	f_lu *lu = createLU(m);
+	
+	if(lu == NULL) {
+		return 0.0f;
 	}
 	
-	memcpy(m->data, result.data, m->rows * m->cols * sizeof(float));
-	return m;
+	float determinant = determinantLU(lu);
+	
+	destroyLU(lu);
+	
+	return determinant;
 }
 
 /*Translation, rotation and scale return, as of now, 4x4 matrices*/
@@ -142,6 +1960,8 @@ f_matrix *translationMatrix(float x, float y, float z) {
 	setMatrixValue(m, 1, 3, y);
 	setMatrixValue(m, 2, 3, z);
 	
+	m->structure = TRANSLATION_MATRIX;
+	
 	return m;	
 }
 
@@ -155,6 +1975,8 @@ f_matrix *scaleMatrix(float s) {
 	setMatrixValue(m, 2, 2, s);
 	setMatrixValue(m, 3, 3, 1.0f);
 	
+	m->structure = SCALE_MATRIX;
+	
 	return m;	
 }
 
@@ -164,18 +1986,23 @@ f_matrix *rotateXMatrix(float theta) {
 	
 	theta = radiansOf(theta);
 	
+	float c = cos(theta);
+	float s = sin(theta);
+	
 	f_matrix *m = createSquareMatrix(matrix_dim);
 	
 	setMatrixValue(m, 0, 0, 1.0f);
 	
-	setMatrixValue(m, 1, 1, cos(theta));
-	setMatrixValue(m, 1, 2, -sin(theta));
+	setMatrixValue(m, 1, 1, c);
+	setMatrixValue(m, 1, 2, -s);
 	
-	setMatrixValue(m, 2, 1, sin(theta));
-	setMatrixValue(m, 2, 2, cos(theta));
+	setMatrixValue(m, 2, 1, s);
+	setMatrixValue(m, 2, 2, c);
 	
 	setMatrixValue(m, 3, 3, 1.0f);
 	
+	m->structure = AFFINE_MATRIX;
+	
 	return m;	
 }
 
@@ -185,18 +2012,23 @@ f_matrix *rotateYMatrix(float theta) {
 	
 	theta = radiansOf(theta);
 	
+	float c = cos(theta);
+	float s = sin(theta);
+	
 	f_matrix *m = createSquareMatrix(matrix_dim);
 	
-	setMatrixValue(m, 0, 0, cos(theta));
-	setMatrixValue(m, 0, 2, sin(theta));
+	setMatrixValue(m, 0, 0, c);
+	setMatrixValue(m, 0, 2, s);
 	
 	setMatrixValue(m, 1, 1, 1.0f);
 	
-	setMatrixValue(m, 2, 0, -sin(theta));
-	setMatrixValue(m, 2, 2, cos(theta));
+	setMatrixValue(m, 2, 0, -s);
+	setMatrixValue(m, 2, 2, c);
 	
 	setMatrixValue(m, 3, 3, 1.0f);
 	
+	m->structure = AFFINE_MATRIX;
+	
 	return m;	
 }
 
@@ -206,18 +2038,23 @@ f_matrix *rotateZMatrix(float theta) {
 	
 	theta = radiansOf(theta);
 	
+	float c = cos(theta);
+	float s = sin(theta);
+	
 	f_matrix *m = createSquareMatrix(matrix_dim);
 	
-	setMatrixValue(m, 0, 0, cos(theta));
-	setMatrixValue(m, 0, 1, -sin(theta));
+	setMatrixValue(m, 0, 0, c);
+	setMatrixValue(m, 0, 1, -s);
 	
-	setMatrixValue(m, 1, 0, sin(theta));
-	setMatrixValue(m, 1, 1, cos(theta));
+	setMatrixValue(m, 1, 0, s);
+	setMatrixValue(m, 1, 1, c);
 	
 	setMatrixValue(m, 2, 2, 1.0f);
 	
 	setMatrixValue(m, 3, 3, 1.0f);
 	
+	m->structure = AFFINE_MATRIX;
+	
 	return m;	
 }
 
@@ -257,17 +2094,21 @@ void DEBUG_data_dump(f_matrix *m) {
 }
 
 f_vec *createVec(size_t size) {
-	f_vec *v = malloc(sizeof(f_vec));
+	f_vec *v = (current_arena != NULL ? arenaAlloc(current_arena, sizeof(f_vec)) : mathMalloc(sizeof(f_vec)));
 
 	v->size = size;
-	v->data = calloc(size, sizeof(float));
+	v->data = allocFloats(current_arena, size);
+	v->arena = current_arena;
 	
 	return v;
 }
 
+//Does nothing for vectors allocated from an arena - they go away when it's reset
 void destroyVec(f_vec *v) {
-	free(v->data);
-	free(v);
+	if(v->arena == NULL) {
+		free(v->data);
+		free(v);
+	}
 }
 
 f_vec *copyVec(f_vec *v) {
@@ -387,6 +2228,7 @@ f_matrix *lookAt(f_vec *eye, f_vec *at, f_vec *up) {
 	
 	if(vecEqual(eye, at)) {
 		makeIdentity(m);
+		m->structure = IDENTITY_MATRIX;
 		
 		return m;
 	}
@@ -417,6 +2259,7 @@ f_matrix *lookAt(f_vec *eye, f_vec *at, f_vec *up) {
 	setMatrixValue(m, 2, 3, -doteyen);
 	
 	setMatrixValue(m, 3, 3, 1.0f);
+	m->structure = AFFINE_MATRIX;
 	
 	destroyVec(temp1);
 	destroyVec(n);
@@ -450,6 +2293,7 @@ f_matrix *ortho(float l, float r, float b, float t, float n, float f) {
 	setMatrixValue(result, 2, 3, -(n + f)/d);
 	
 	setMatrixValue(result, 3, 3, 1.0f);
+	result->structure = AFFINE_MATRIX;
 	
 	return result;
 }
@@ -463,5 +2307,465 @@ void DEBUG_vector_dump(f_vec *v) {
 	}
 	printf("\n\n");
 }
+
+/*Fixed-size value types
+ *mat4 entries are addressed as data[col*4 + row], just like setMatrixValue does for a 4x4 f_matrix*/
+void makeIdentityMat4(mat4 *m) {
+	memset(m->data, 0, sizeof(m->data));
+	
+	m->data[0] = 1.0f;
+	m->data[5] = 1.0f;
+	m->data[10] = 1.0f;
+	m->data[15] = 1.0f;
+}
+
+void translationMat4(mat4 *m, float x, float y, float z) {
+	makeIdentityMat4(m);
+	
+	m->data[12] = x;
+	m->data[13] = y;
+	m->data[14] = z;
+}
+
+void scaleMat4(mat4 *m, float s) {
+	memset(m->data, 0, sizeof(m->data));
+	
+	m->data[0] = s;
+	m->data[5] = s;
+	m->data[10] = s;
+	m->data[15] = 1.0f;
+}
+
+//Works in degrees
+void rotateXMat4(mat4 *m, float theta) {
+	theta = radiansOf(theta);
+	
+	float c = cos(theta);
+	float s = sin(theta);
+	
+	makeIdentityMat4(m);
+	
+	m->data[5] = c;
+	m->data[6] = s;
+	m->data[9] = -s;
+	m->data[10] = c;
+}
+
+//Works in degrees
+void rotateYMat4(mat4 *m, float theta) {
+	theta = radiansOf(theta);
+	
+	float c = cos(theta);
+	float s = sin(theta);
+	
+	makeIdentityMat4(m);
+	
+	m->data[0] = c;
+	m->data[2] = -s;
+	m->data[8] = s;
+	m->data[10] = c;
+}
+
+//Works in degrees
+void rotateZMat4(mat4 *m, float theta) {
+	theta = radiansOf(theta);
+	
+	float c = cos(theta);
+	float s = sin(theta);
+	
+	makeIdentityMat4(m);
+	
+	m->data[0] = c;
+	m->data[1] = s;
+	m->data[4] = -s;
+	m->data[5] = c;
+}
+
+//result is a * b
+void multMat4(mat4 *result, mat4 const *a, mat4 const *b) {
+	mult4x4(result->data, a->data, b->data);
+}
+
+//result is m * v
+void multMat4Vec4(vec4 *result, mat4 const *m, vec4 const *v) {
+	float data[4];
+	
+	mult4x4Vec(data, m->data, v->data);
+	
+	memcpy(result->data, data, sizeof(data));
+}
+
+int inverseMat4(mat4 *result, mat4 const *m) {
+	return inverse4x4(result->data, m->data);
+}
+
+/*Affine inverse
+ *With A the upper 3x3 and t the translation, the inverse is A^-1 with -A^-1 * t as its translation. The rows of A^-1 are the
+ *cross products of A's columns (c1 x c2, c2 x c0, c0 x c1) divided by the determinant; stored as columns, they're the inverse transpose*/
+static int inverse3x3Rows(vec3 rows[3], float const *m) {
+	float r0x = m[5]*m[10] - m[6]*m[9];
+	float r0y = m[6]*m[8] - m[4]*m[10];
+	float r0z = m[4]*m[9] - m[5]*m[8];
+	
+	float det = m[0]*r0x + m[1]*r0y + m[2]*r0z;
+	if(det == 0.0f) {
+		return 0;
+	}
+	
+	float inverseDet = 1.0f/det;
+	
+	setVec3(&rows[0], r0x * inverseDet, r0y * inverseDet, r0z * inverseDet);
+	setVec3(&rows[1], (m[9]*m[2] - m[10]*m[1]) * inverseDet, (m[10]*m[0] - m[8]*m[2]) * inverseDet, (m[8]*m[1] - m[9]*m[0]) * inverseDet);
+	setVec3(&rows[2], (m[1]*m[6] - m[2]*m[5]) * inverseDet, (m[2]*m[4] - m[0]*m[6]) * inverseDet, (m[0]*m[5] - m[1]*m[4]) * inverseDet);
+	
+	return 1;
+}
+
+int affineInverseMat4(mat4 *result, mat4 const *m) {
+	vec3 rows[3];
+	if(!inverse3x3Rows(rows, m->data)) {
+		return 0;
+	}
+	
+	vec3 translation;
+	setVec3(&translation, m->data[12], m->data[13], m->data[14]);
+	
+	size_t i;
+	for(i = 0; i < 3; ++i) {
+		result->data[i] = rows[i].data[0];
+		result->data[4 + i] = rows[i].data[1];
+		result->data[8 + i] = rows[i].data[2];
+		result->data[12 + i] = -dotProductVec3(&rows[i], &translation);
+	}
+	
+	result->data[3] = 0.0f;
+	result->data[7] = 0.0f;
+	result->data[11] = 0.0f;
+	result->data[15] = 1.0f;
+	
+	return 1;
+}
+
+int inverseTransposeMat4(mat4 *result, mat4 const *m) {
+	vec3 rows[3];
+	if(!inverse3x3Rows(rows, m->data)) {
+		return 0;
+	}
+	
+	memset(result->data, 0, sizeof(result->data));
+	
+	size_t i;
+	for(i = 0; i < 3; ++i) {
+		memcpy(result->data + i*4, rows[i].data, sizeof(rows[i].data));
+	}
+	
+	result->data[15] = 1.0f;
+	
+	return 1;
+}
+
+void lookAtMat4(mat4 *m, vec3 const *eye, vec3 const *at, vec3 const *up) {
+	if(eye->data[0] == at->data[0] && eye->data[1] == at->data[1] && eye->data[2] == at->data[2]) {
+		makeIdentityMat4(m);
+		
+		return;
+	}
+	
+	vec3 n, u, v;
+	
+	subtractVec3(&n, eye, at);
+	normalizeVec3(&n, &n);
+	crossProductVec3(&u, up, &n);
+	normalizeVec3(&u, &u);
+	crossProductVec3(&v, &n, &u);
+	normalizeVec3(&v, &v);
+	
+	float doteyeu = dotProductVec3(eye, &u);
+	float doteyev = dotProductVec3(eye, &v);
+	float doteyen = dotProductVec3(eye, &n);
+	
+	m->data[0] = u.data[0];
+	m->data[4] = u.data[1];
+	m->data[8] = u.data[2];
+	m->data[12] = -doteyeu;
+	
+	m->data[1] = v.data[0];
+	m->data[5] = v.data[1];
+	m->data[9] = v.data[2];
+	m->data[13] = -doteyev;
+	
+	m->data[2] = n.data[0];
+	m->data[6] = n.data[1];
+	m->data[10] = n.data[2];
+	m->data[14] = -doteyen;
+	
+	m->data[3] = 0.0f;
+	m->data[7] = 0.0f;
+	m->data[11] = 0.0f;
+	m->data[15] = 1.0f;
+}
+
+//returns 0 on error, in which case m is left untouched
+//don't forget we consider that z points INTO the screen when using this function - therefore near < far
+int orthoMat4(mat4 *m, float l, float r, float b, float t, float n, float f) {
+	if(l == r || b == t || n == f) {
+		return 0;
+	}
+	
+	float w = r - l;
+	float h = t - b;
+	float d = f - n;
+	
+	memset(m->data, 0, sizeof(m->data));
+	
+	m->data[0] = 2.0f/w;
+	m->data[5] = 2.0f/h;
+	m->data[10] = -2.0f/d;
+	
+	m->data[12] = -(l + r)/w;
+	m->data[13] = -(t + b)/h;
+	m->data[14] = -(n + f)/d;
+	
+	m->data[15] = 1.0f;
+	
+	return 1;
+}
+
+//Wraps a mat4 in an f_matrix without copying - the result must not be passed to destroyMatrix or to a DESTRUCTIVE_MULT
+f_matrix matrixOfMat4(mat4 *m) {
+	f_matrix result;
+	
+	result.rows = 4;
+	result.cols = 4;
+	result.data = m->data;
+	result.arena = NULL;
+	result.structure = GENERAL_MATRIX;
+	
+	return result;
+}
+
+void setVec3(vec3 *v, float x, float y, float z) {
+	v->data[0] = x;
+	v->data[1] = y;
+	v->data[2] = z;
+}
+
+void setVec4(vec4 *v, float x, float y, float z, float w) {
+	v->data[0] = x;
+	v->data[1] = y;
+	v->data[2] = z;
+	v->data[3] = w;
+}
+
+//result is a - b
+void subtractVec3(vec3 *result, vec3 const *a, vec3 const *b) {
+	setVec3(result, a->data[0] - b->data[0], a->data[1] - b->data[1], a->data[2] - b->data[2]);
+}
+
+void crossProductVec3(vec3 *result, vec3 const *a, vec3 const *b) {
+	float x, y, z;
+	
+	x = a->data[1] * b->data[2] - a->data[2] * b->data[1];
+	y = a->data[2] * b->data[0] - a->data[0] * b->data[2];
+	z = a->data[0] * b->data[1] - a->data[1] * b->data[0];
+	
+	setVec3(result, x, y, z);
+}
+
+float dotProductVec3(vec3 const *a, vec3 const *b) {
+	return a->data[0] * b->data[0] + a->data[1] * b->data[1] + a->data[2] * b->data[2];
+}
+
+void normalizeVec3(vec3 *result, vec3 const *v) {
+	float vecLength = sqrt(dotProductVec3(v, v));
+	float inverseLength = 1.0f/vecLength;
+	
+	setVec3(result, v->data[0] * inverseLength, v->data[1] * inverseLength, v->data[2] * inverseLength);
+}
+
+/*Quaternions
+ *A rotation by theta about the unit axis (x, y, z) is (x*sin(theta/2), y*sin(theta/2), z*sin(theta/2), cos(theta/2))*/
+void makeIdentityQuat(quat *q) {
+	q->data[0] = 0.0f;
+	q->data[1] = 0.0f;
+	q->data[2] = 0.0f;
+	q->data[3] = 1.0f;
+}
+
+//Works in degrees; axis needn't be normalised
+void axisAngleQuat(quat *q, vec3 const *axis, float theta) {
+	vec3 unit;
+	normalizeVec3(&unit, axis);
+	
+	float half = radiansOf(theta) * 0.5f;
+	float s = sin(half);
+	
+	q->data[0] = unit.data[0] * s;
+	q->data[1] = unit.data[1] * s;
+	q->data[2] = unit.data[2] * s;
+	q->data[3] = cos(half);
+}
+
+//Works in degrees; one sine and one cosine per angle, and no matrix products
+void eulerQuat(quat *q, float x, float y, float z) {
+	float hx = radiansOf(x) * 0.5f;
+	float hy = radiansOf(y) * 0.5f;
+	float hz = radiansOf(z) * 0.5f;
+	
+	float cx = cos(hx), sx = sin(hx);
+	float cy = cos(hy), sy = sin(hy);
+	float cz = cos(hz), sz = sin(hz);
+	
+	//(0, 0, sz, cz) * (0, sy, 0, cy) * (sx, 0, 0, cx), expanded
+	q->data[0] = cz*cy*sx - sz*sy*cx;
+	q->data[1] = cz*sy*cx + sz*cy*sx;
+	q->data[2] = sz*cy*cx - cz*sy*sx;
+	q->data[3] = cz*cy*cx + sz*sy*sx;
+}
+
+//result is a * b
+void multQuat(quat *result, quat const *a, quat const *b) {
+	float ax = a->data[0], ay = a->data[1], az = a->data[2], aw = a->data[3];
+	float bx = b->data[0], by = b->data[1], bz = b->data[2], bw = b->data[3];
+	
+	result->data[0] = aw*bx + ax*bw + ay*bz - az*by;
+	result->data[1] = aw*by - ax*bz + ay*bw + az*bx;
+	result->data[2] = aw*bz + ax*by - ay*bx + az*bw;
+	result->data[3] = aw*bw - ax*bx - ay*by - az*bz;
+}
+
+static float dotQuat(quat const *a, quat const *b) {
+	return a->data[0]*b->data[0] + a->data[1]*b->data[1] + a->data[2]*b->data[2] + a->data[3]*b->data[3];
+}
+
+void normalizeQuat(quat *result, quat const *q) {
+	float inverseLength = 1.0f/sqrt(dotQuat(q, q));
+	
+	size_t i;
+	for(i = 0; i < 4; ++i) {
+		result->data[i] = q->data[i] * inverseLength;
+	}
+}
+
+void nlerpQuat(quat *result, quat const *a, quat const *b, float t) {
+	//q and -q are the same rotation; going towards whichever is closer to a takes the shorter arc
+	float wb = dotQuat(a, b) < 0.0f ? -t : t;
+	float wa = 1.0f - t;
+	
+	quat blend;
+	size_t i;
+	for(i = 0; i < 4; ++i) {
+		blend.data[i] = wa * a->data[i] + wb * b->data[i];
+	}
+	
+	normalizeQuat(result, &blend);
+}
+
+void slerpQuat(quat *result, quat const *a, quat const *b, float t) {
+	float d = dotQuat(a, b);
+	float sign = 1.0f;
 	
-	
\ No newline at end of file
+	if(d < 0.0f) {
+		d = -d;
+		sign = -1.0f;
+	}
+	
+	//Nearly the same rotation: sin(angle) would be too close to 0 to divide by, and nlerp is just as good there
+	if(d > 0.9995f) {
+		nlerpQuat(result, a, b, t);
+		
+		return;
+	}
+	
+	float angle = acos(d);
+	float inverseSin = 1.0f/sin(angle);
+	float wa = sin((1.0f - t) * angle) * inverseSin;
+	float wb = sign * sin(t * angle) * inverseSin;
+	
+	quat blend;
+	size_t i;
+	for(i = 0; i < 4; ++i) {
+		blend.data[i] = wa * a->data[i] + wb * b->data[i];
+	}
+	
+	normalizeQuat(result, &blend);
+}
+
+//The rotation part of trsMat4, columns scaled by sx, sy and sz
+static void rotationScaleMat4(mat4 *m, quat const *q, float sx, float sy, float sz) {
+	float x = q->data[0], y = q->data[1], z = q->data[2], w = q->data[3];
+	
+	float xx = x*x, yy = y*y, zz = z*z;
+	float xy = x*y, xz = x*z, yz = y*z;
+	float wx = w*x, wy = w*y, wz = w*z;
+	
+	m->data[0] = (1.0f - 2.0f*(yy + zz)) * sx;
+	m->data[1] = 2.0f*(xy + wz) * sx;
+	m->data[2] = 2.0f*(xz - wy) * sx;
+	m->data[3] = 0.0f;
+	
+	m->data[4] = 2.0f*(xy - wz) * sy;
+	m->data[5] = (1.0f - 2.0f*(xx + zz)) * sy;
+	m->data[6] = 2.0f*(yz + wx) * sy;
+	m->data[7] = 0.0f;
+	
+	m->data[8] = 2.0f*(xz + wy) * sz;
+	m->data[9] = 2.0f*(yz - wx) * sz;
+	m->data[10] = (1.0f - 2.0f*(xx + yy)) * sz;
+	m->data[11] = 0.0f;
+	
+	m->data[12] = 0.0f;
+	m->data[13] = 0.0f;
+	m->data[14] = 0.0f;
+	m->data[15] = 1.0f;
+}
+
+void rotationMat4(mat4 *m, quat const *q) {
+	rotationScaleMat4(m, q, 1.0f, 1.0f, 1.0f);
+}
+
+void trsMat4(mat4 *m, vec3 const *translation, quat const *rotation, vec3 const *scale) {
+	rotationScaleMat4(m, rotation, scale->data[0], scale->data[1], scale->data[2]);
+	
+	m->data[12] = translation->data[0];
+	m->data[13] = translation->data[1];
+	m->data[14] = translation->data[2];
+}
+
+//Applies m to count packed xyz points (w taken as 1, m's bottom row ignored) - out may be the same array as in
+void transformPoints(mat4 const *m, float const *in, float *out, size_t count) {
+	transformPacked(m->data, in, out, count);
+}
+
+//Same as transformPoints, for points stored as separate x, y and z arrays - each output array may be the same as its input
+void transformPointsSoA(mat4 const *m, float const *x, float const *y, float const *z, float *out_x, float *out_y, float *out_z, size_t count) {
+	transformSoA(m->data, x, y, z, out_x, out_y, out_z, count);
+}
+
+//Gribb and Hartmann's extraction: with r0..r3 the rows of m, a point is inside when -w <= x, y, z <= w, i.e. r3 +/- ri >= 0
+void frustumFromMat4(frustum *f, mat4 const *m) {
+	float const *d = m->data;
+	
+	size_t i;
+	for(i = 0; i < 3; ++i) {
+		vec4 *lower = &f->planes[i*2];
+		vec4 *upper = &f->planes[i*2 + 1];
+		
+		setVec4(lower, d[3] + d[i], d[7] + d[4 + i], d[11] + d[8 + i], d[15] + d[12 + i]);
+		setVec4(upper, d[3] - d[i], d[7] - d[4 + i], d[11] - d[8 + i], d[15] - d[12 + i]);
+	}
+	
+	//Normalised, so that a plane's equation gives actual distances
+	for(i = 0; i < 6; ++i) {
+		float *plane = f->planes[i].data;
+		float inverseLength = 1.0f/sqrtf(plane[0]*plane[0] + plane[1]*plane[1] + plane[2]*plane[2]);
+		
+		setVec4(&f->planes[i], plane[0] * inverseLength, plane[1] * inverseLength, plane[2] * inverseLength, plane[3] * inverseLength);
+	}
+}
+
+size_t frustumCullBoxes(frustum const *f, float const *center_x, float const *center_y, float const *center_z,
+						float const *extent_x, float const *extent_y, float const *extent_z, size_t count, unsigned int *visible) {
+	//vec4 is exactly 4 floats, so the planes are already laid out as the kernels want them
+	return cullBoxes(f->planes[0].data, center_x, center_y, center_z, extent_x, extent_y, extent_z, 0, count, visible);
+}
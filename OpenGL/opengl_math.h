@@ -1,12 +1,59 @@
+#ifndef OPENGL_MATH_H
+#define OPENGL_MATH_H
+
 #include <stdlib.h>
 #include <math.h>
 
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+//Heap allocations made by the library since the program started, across all threads
+size_t mathAllocationCount(void);
+
+//See createArena
+typedef struct f_arena f_arena;
+
+/*What is known about a 4x4 matrix's layout, which lets multMatrix skip the products of entries known to be 0 or 1
+ *The constructors below set it, products propagate it, and setMatrixValue (and everything built on it) resets it to GENERAL_MATRIX
+ *Code writing to data directly must do the same. It's always GENERAL_MATRIX for matrices that aren't 4x4*/
+typedef enum {
+	GENERAL_MATRIX,		//nothing known
+	IDENTITY_MATRIX,
+	TRANSLATION_MATRIX,	//identity but for the translation column
+	SCALE_MATRIX,		//diagonal, with a 1 in the bottom right corner
+	AFFINE_MATRIX		//bottom row is (0, 0, 0, 1)
+} MATRIX_STRUCTURE;
+
 typedef struct {
 	size_t rows;
 	size_t cols;
 	float *data;
+	f_arena *arena;	//where the matrix was allocated from, NULL for the heap
+	MATRIX_STRUCTURE structure;
 } f_matrix;
 
+/*Arenas
+ *While an arena is in use (see useArena), every constructor below - createMatrix, translationMatrix, lookAt, subtractVec, crossProduct,
+ *normalizeVec and so on - allocates from it instead of the heap, and destroyMatrix/destroyVec leave such objects alone
+ *Everything allocated from an arena is released at once by resetArena, typically at the end of each frame*/
+
+//bytes is the size of each block the arena grows by
+//returns NULL on failure
+f_arena *createArena(size_t bytes);
+
+//Invalidates everything allocated from the arena, keeping its memory for reuse
+void resetArena(f_arena *arena);
+
+void destroyArena(f_arena *arena);
+
+//Zeroed, 16 byte aligned memory; returns NULL on failure
+void *arenaAlloc(f_arena *arena, size_t bytes);
+
+//Makes the calling thread's constructors allocate from arena (NULL goes back to the heap)
+//returns the arena that was in use until now, so calls can be nested
+f_arena *useArena(f_arena *arena);
+
 f_matrix *createSquareMatrix(size_t size);
 
 f_matrix *createMatrix(size_t rows, size_t columns);
@@ -35,15 +82,78 @@ typedef enum {PURE_MULT, DESTRUCTIVE_MULT_A, DESTRUCTIVE_MULT_B} MULT_MODE;
 //PURE_MULT -> Preserves both arguments, returns a newly allocated matrix (with createMatrix)
 //DESTRUCTIVE_MULT -> If successful, destructively alters the right side matrix/the second argument, with the return value being the pointer passed in the 2nd arg
 //result is a * b
-//invalidates references to b->data when in DESTRUCTIVE_MULT mode (actually, no it doesn't, since it uses realloc, but it's safer to assume so)
+//invalidates references to b->data when in DESTRUCTIVE_MULT mode (only 4x4 products are written in place)
+//4x4 * 4x4 products use an SSE/AVX kernel when the CPU has one, giving the same results as the scalar loop
+//When both 4x4 operands' structure is known, only the entries that can be nonzero are computed, with the same results again
+//Larger products use a cache-blocked kernel with heap workspace, so they aren't limited by stack size
 f_matrix *multMatrix(f_matrix *a, f_matrix *b, MULT_MODE mode);
 
+//Floats of workspace multMatrixInto needs for a * b (0 when it needs none)
+size_t multMatrixWorkspaceSize(f_matrix *a, f_matrix *b);
+
+//Returns NULL on failure
+//result must already be a->rows x b->cols and must not share data with a or b
+//workspace must hold multMatrixWorkspaceSize(a, b) floats, or be NULL to have it allocated and freed internally
+f_matrix *multMatrixInto(f_matrix *result, f_matrix *a, f_matrix *b, float *workspace);
+
+/*Library-wide thread pool, used by multMatrixParallel and the LU functions
+ *Create it once at startup and reuse it - without one, everything runs on the calling thread*/
+
+//workers == 0 -> one worker per online processor, besides the calling thread
+//returns 0 on failure, or if there already is a pool
+int createMathThreadPool(size_t workers);
+
+void destroyMathThreadPool(void);
+
+//Number of workers, not counting the calling thread (0 when there is no pool)
+size_t mathThreadPoolSize(void);
+
+//Multiply-adds (rows * cols * shared dimension) below which multMatrixParallel stays on the calling thread
+#define PARALLEL_MULT_THRESHOLD (128 * 128 * 128)
+
+//Same contract as multMatrix, but products above PARALLEL_MULT_THRESHOLD are split across the thread pool
+f_matrix *multMatrixParallel(f_matrix *a, f_matrix *b, MULT_MODE mode);
+
+/*Linear systems
+ *LU decomposition with partial pivoting, P * m = L * U, for square matrices of any size. It's cache-blocked, with nearly all of its work
+ *done by the same kernel as multMatrix, and splits the larger steps across the thread pool when there is one*/
+typedef struct {
+	f_matrix *lu;		//L below the diagonal (its diagonal of ones isn't stored), U on and above it
+	size_t *pivots;		//row i was swapped with row pivots[i], for every i in order
+	int sign;			//of the permutation, 1 or -1
+} f_lu;
+
+//Returns NULL if m isn't square or on allocation failure
+//Singular matrices still factor - solveLU and inverseMatrix are the ones to fail on them
+f_lu *createLU(f_matrix *m);
+
+void destroyLU(f_lu *lu);
+
+//Whether U has an exact zero on its diagonal; nearly singular matrices give huge or infinite results instead
+int isSingularLU(f_lu *lu);
+
+//Overwrites b (n x k, any number of right hand sides) with the solution x of m * x = b
+//returns 0, leaving b untouched, if b doesn't have n rows, if the matrix is singular or on allocation failure
+int solveLU(f_lu *lu, f_matrix *b);
+
+//Accumulated in double, but the result can still overflow a float for large matrices
+float determinantLU(f_lu *lu);
+
+//Returns x with a * x = b, newly allocated, or NULL on failure (see solveLU)
+f_matrix *solveMatrix(f_matrix *a, f_matrix *b);
+
+//Returns NULL if m isn't square, is singular or on allocation failure
+f_matrix *inverseMatrix(f_matrix *m);
+
+//0 if m isn't square
+float matrixDeterminant(f_matrix *m);
+
 /*Translation, rotation and scale return, as of now, 4x4 matrices*/
 f_matrix *translationMatrix(float x, float y, float z);
 
 f_matrix *scaleMatrix(float s);
 
-#define PI acos(-1.0)
+#define PI 3.14159265358979323846
 
 //Works in degrees
 f_matrix *rotateXMatrix(float theta);
@@ -67,6 +177,7 @@ void DEBUG_data_dump(f_matrix *m);
 typedef struct {
 	size_t size;
 	float *data;
+	f_arena *arena;	//where the vector was allocated from, NULL for the heap
 } f_vec;
 
 f_vec *createVec(size_t size);
@@ -104,3 +215,135 @@ f_matrix *ortho(float l, float r, float b, float t, float n, float f);
 
 //Dumps the contents of a vector
 void DEBUG_vector_dump(f_vec *v);
+
+/*Fixed-size value types
+ *mat4 uses the same column-major layout as a 4x4 f_matrix, so its data can be handed straight to glUniformMatrix4fv
+ *Nothing below allocates: results are written into caller storage, which may alias any of the arguments*/
+typedef struct {
+	float data[16];
+} mat4;
+
+typedef struct {
+	float data[3];
+} vec3;
+
+typedef struct {
+	float data[4];
+} vec4;
+
+//Rotation quaternion, stored as x, y, z, w
+typedef struct {
+	float data[4];
+} quat;
+
+void makeIdentityMat4(mat4 *m);
+
+void translationMat4(mat4 *m, float x, float y, float z);
+
+void scaleMat4(mat4 *m, float s);
+
+//Works in degrees
+void rotateXMat4(mat4 *m, float theta);
+
+//Works in degrees
+void rotateYMat4(mat4 *m, float theta);
+
+//Works in degrees
+void rotateZMat4(mat4 *m, float theta);
+
+//result is a * b
+void multMat4(mat4 *result, mat4 const *a, mat4 const *b);
+
+//result is m * v
+void multMat4Vec4(vec4 *result, mat4 const *m, vec4 const *v);
+
+/*Inverses
+ *All of them return 0 when m is singular, in which case result is left untouched*/
+
+//Any invertible matrix
+int inverseMat4(mat4 *result, mat4 const *m);
+
+//Only for matrices whose bottom row is (0, 0, 0, 1) - translations, rotations, scales, lookAt and their products - which it's cheaper for
+int affineInverseMat4(mat4 *result, mat4 const *m);
+
+//The inverse transpose of m's upper 3x3, with no translation: the matrix that transforms normals the way m transforms points
+int inverseTransposeMat4(mat4 *result, mat4 const *m);
+
+void lookAtMat4(mat4 *m, vec3 const *eye, vec3 const *at, vec3 const *up);
+
+//returns 0 on error, in which case m is left untouched
+//same conventions as ortho
+int orthoMat4(mat4 *m, float l, float r, float b, float t, float n, float f);
+
+//Wraps a mat4 in an f_matrix without copying - the result must not be passed to destroyMatrix or to a DESTRUCTIVE_MULT
+f_matrix matrixOfMat4(mat4 *m);
+
+void setVec3(vec3 *v, float x, float y, float z);
+
+void setVec4(vec4 *v, float x, float y, float z, float w);
+
+//result is a - b
+void subtractVec3(vec3 *result, vec3 const *a, vec3 const *b);
+
+void crossProductVec3(vec3 *result, vec3 const *a, vec3 const *b);
+
+float dotProductVec3(vec3 const *a, vec3 const *b);
+
+void normalizeVec3(vec3 *result, vec3 const *v);
+
+/*Quaternions
+ *Compose like rotation matrices: with q = a * b, rotating by q is rotating by b and then by a*/
+void makeIdentityQuat(quat *q);
+
+//Works in degrees; axis needn't be normalised
+void axisAngleQuat(quat *q, vec3 const *axis, float theta);
+
+//Works in degrees; rotates about X, then Y, then Z, like rotateZMat4 * rotateYMat4 * rotateXMat4
+void eulerQuat(quat *q, float x, float y, float z);
+
+//result is a * b
+void multQuat(quat *result, quat const *a, quat const *b);
+
+void normalizeQuat(quat *result, quat const *q);
+
+//Both interpolate along the shorter arc, t going from 0 (a) to 1 (b); the result is normalised
+//nlerp is cheaper, but doesn't move at a constant angular speed
+void nlerpQuat(quat *result, quat const *a, quat const *b, float t);
+
+void slerpQuat(quat *result, quat const *a, quat const *b, float t);
+
+//q must be normalised
+void rotationMat4(mat4 *m, quat const *q);
+
+//Translation * rotation * scale, written directly rather than multiplied together; rotation must be normalised
+void trsMat4(mat4 *m, vec3 const *translation, quat const *rotation, vec3 const *scale);
+
+/*Batched point transforms
+ *Points are taken to have w = 1 and m's bottom row is ignored, which is exact for every matrix this library builds*/
+
+//Applies m to count packed xyz points - out may be the same array as in
+void transformPoints(mat4 const *m, float const *in, float *out, size_t count);
+
+//Same as transformPoints, for points stored as separate x, y and z arrays - each output array may be the same as its input
+void transformPointsSoA(mat4 const *m, float const *x, float const *y, float const *z, float *out_x, float *out_y, float *out_z, size_t count);
+
+/*Frustum culling
+ *Each plane is (a, b, c, d), with a*x + b*y + c*z + d the signed distance to it, positive on the inside*/
+typedef struct {
+	vec4 planes[6];	//left, right, bottom, top, near, far
+} frustum;
+
+//Extracts the planes of m's clip volume - for projection * view, they're in world space
+void frustumFromMat4(frustum *f, mat4 const *m);
+
+//Tests count axis-aligned boxes, given by their centres and half-extents, against f
+//Writes the indices of those that may be visible to visible (which needs room for count indices) in increasing order, and returns how many there are
+//Conservative: a box just outside a corner of the frustum may be kept, but a box that's even partly inside is never culled
+size_t frustumCullBoxes(frustum const *f, float const *center_x, float const *center_y, float const *center_z,
+						float const *extent_x, float const *extent_y, float const *extent_z, size_t count, unsigned int *visible);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
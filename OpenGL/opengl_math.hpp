@@ -0,0 +1,301 @@
+#ifndef OPENGL_MATH_HPP
+#define OPENGL_MATH_HPP
+
+#include <cstddef>
+#include <cmath>
+#include "opengl_math.h"
+
+/*Fixed-size matrices and vectors for C++ (C++14 or later)
+ *Dimensions are template parameters, so every loop below has constant bounds the compiler can unroll and vectorise, and
+ *whatever is built from constants - fixedTranslation, fixedOrtho and products of them - can be computed at compile time
+ *Storage is column-major like f_matrix and mat4, so data can go straight to glUniformMatrix4fv or be wrapped with matrixOf
+ *Products add in the same ((a0*b0 + a1*b1) + a2*b2) + ... order as opengl_math.c's kernels, so they give the same floats
+ *as long as the compiler isn't allowed to fuse multiply-adds (-ffp-contract=off, or building without FMA enabled)*/
+namespace opengl_math {
+
+template<std::size_t Rows, std::size_t Cols>
+struct fixed_matrix {
+	float data[Rows * Cols];
+
+	static constexpr std::size_t rows = Rows;
+	static constexpr std::size_t cols = Cols;
+
+	constexpr float &operator()(std::size_t row, std::size_t col) {
+		return data[col*Rows + row];
+	}
+
+	constexpr float operator()(std::size_t row, std::size_t col) const {
+		return data[col*Rows + row];
+	}
+};
+
+template<std::size_t Size>
+struct fixed_vec {
+	float data[Size];
+
+	static constexpr std::size_t size = Size;
+
+	constexpr float &operator[](std::size_t i) {
+		return data[i];
+	}
+
+	constexpr float operator[](std::size_t i) const {
+		return data[i];
+	}
+};
+
+typedef fixed_matrix<2, 2> fixed_mat2;
+typedef fixed_matrix<3, 3> fixed_mat3;
+typedef fixed_matrix<4, 4> fixed_mat4;
+
+typedef fixed_vec<2> fixed_vec2;
+typedef fixed_vec<3> fixed_vec3;
+typedef fixed_vec<4> fixed_vec4;
+
+//All zeroes
+template<std::size_t Rows, std::size_t Cols>
+constexpr fixed_matrix<Rows, Cols> fixedZero() {
+	fixed_matrix<Rows, Cols> m = {};
+
+	return m;
+}
+
+template<std::size_t Size>
+constexpr fixed_matrix<Size, Size> fixedIdentity() {
+	fixed_matrix<Size, Size> m = {};
+
+	for(std::size_t i = 0; i < Size; ++i) {
+		m(i, i) = 1.0f;
+	}
+
+	return m;
+}
+
+constexpr fixed_mat4 fixedTranslation(float x, float y, float z) {
+	fixed_mat4 m = fixedIdentity<4>();
+
+	m(0, 3) = x;
+	m(1, 3) = y;
+	m(2, 3) = z;
+
+	return m;
+}
+
+constexpr fixed_mat4 fixedScale(float s) {
+	fixed_mat4 m = {};
+
+	m(0, 0) = s;
+	m(1, 1) = s;
+	m(2, 2) = s;
+	m(3, 3) = 1.0f;
+
+	return m;
+}
+
+//Same as the C ortho - z points INTO the screen, so n < f
+//l == r, b == t or n == f divide by zero, which is a compile error when it's evaluated at compile time
+constexpr fixed_mat4 fixedOrtho(float l, float r, float b, float t, float n, float f) {
+	fixed_mat4 m = {};
+
+	m(0, 0) = 2.0f/(r - l);
+	m(1, 1) = 2.0f/(t - b);
+	m(2, 2) = -2.0f/(f - n);
+
+	m(0, 3) = -(l + r)/(r - l);
+	m(1, 3) = -(t + b)/(t - b);
+	m(2, 3) = -(n + f)/(f - n);
+
+	m(3, 3) = 1.0f;
+
+	return m;
+}
+
+//The rotations can't be constexpr (std::sin and std::cos aren't), but are still inlined
+//Work in degrees
+inline fixed_mat4 fixedRotateX(float theta) {
+	float c = std::cos(radiansOf(theta));
+	float s = std::sin(radiansOf(theta));
+
+	fixed_mat4 m = fixedIdentity<4>();
+
+	m(1, 1) = c;
+	m(2, 1) = s;
+	m(1, 2) = -s;
+	m(2, 2) = c;
+
+	return m;
+}
+
+inline fixed_mat4 fixedRotateY(float theta) {
+	float c = std::cos(radiansOf(theta));
+	float s = std::sin(radiansOf(theta));
+
+	fixed_mat4 m = fixedIdentity<4>();
+
+	m(0, 0) = c;
+	m(2, 0) = -s;
+	m(0, 2) = s;
+	m(2, 2) = c;
+
+	return m;
+}
+
+inline fixed_mat4 fixedRotateZ(float theta) {
+	float c = std::cos(radiansOf(theta));
+	float s = std::sin(radiansOf(theta));
+
+	fixed_mat4 m = fixedIdentity<4>();
+
+	m(0, 0) = c;
+	m(1, 0) = s;
+	m(0, 1) = -s;
+	m(1, 1) = c;
+
+	return m;
+}
+
+template<std::size_t Rows, std::size_t Shared, std::size_t Cols>
+constexpr fixed_matrix<Rows, Cols> operator*(fixed_matrix<Rows, Shared> const &a, fixed_matrix<Shared, Cols> const &b) {
+	fixed_matrix<Rows, Cols> result = {};
+
+	for(std::size_t col = 0; col < Cols; ++col) {
+		for(std::size_t row = 0; row < Rows; ++row) {
+			float val = 0.0f;
+
+			for(std::size_t i = 0; i < Shared; ++i) {
+				val += a(row, i) * b(i, col);
+			}
+
+			result(row, col) = val;
+		}
+	}
+
+	return result;
+}
+
+template<std::size_t Rows, std::size_t Cols>
+constexpr fixed_vec<Rows> operator*(fixed_matrix<Rows, Cols> const &m, fixed_vec<Cols> const &v) {
+	fixed_vec<Rows> result = {};
+
+	for(std::size_t row = 0; row < Rows; ++row) {
+		float val = 0.0f;
+
+		for(std::size_t i = 0; i < Cols; ++i) {
+			val += m(row, i) * v[i];
+		}
+
+		result[row] = val;
+	}
+
+	return result;
+}
+
+template<std::size_t Rows, std::size_t Cols>
+constexpr fixed_matrix<Cols, Rows> transpose(fixed_matrix<Rows, Cols> const &m) {
+	fixed_matrix<Cols, Rows> result = {};
+
+	for(std::size_t col = 0; col < Cols; ++col) {
+		for(std::size_t row = 0; row < Rows; ++row) {
+			result(col, row) = m(row, col);
+		}
+	}
+
+	return result;
+}
+
+//Exact comparison, entry by entry
+template<std::size_t Rows, std::size_t Cols>
+constexpr bool operator==(fixed_matrix<Rows, Cols> const &a, fixed_matrix<Rows, Cols> const &b) {
+	for(std::size_t i = 0; i < Rows * Cols; ++i) {
+		if(a.data[i] != b.data[i]) {
+			return false;
+		}
+	}
+
+	return true;
+}
+
+template<std::size_t Rows, std::size_t Cols>
+constexpr bool operator!=(fixed_matrix<Rows, Cols> const &a, fixed_matrix<Rows, Cols> const &b) {
+	return !(a == b);
+}
+
+/*Interoperability with the C types*/
+
+//Wraps m in an f_matrix without copying, like matrixOfMat4 - the result must not be passed to destroyMatrix or to a DESTRUCTIVE_MULT
+template<std::size_t Rows, std::size_t Cols>
+f_matrix matrixOf(fixed_matrix<Rows, Cols> &m) {
+	f_matrix result;
+
+	result.rows = Rows;
+	result.cols = Cols;
+	result.data = m.data;
+	result.arena = NULL;
+	result.structure = GENERAL_MATRIX;
+
+	return result;
+}
+
+//returns false, leaving result untouched, if m isn't Rows x Cols
+template<std::size_t Rows, std::size_t Cols>
+bool copyMatrixInto(fixed_matrix<Rows, Cols> *result, f_matrix const *m) {
+	if(m->rows != Rows || m->cols != Cols) {
+		return false;
+	}
+
+	for(std::size_t i = 0; i < Rows * Cols; ++i) {
+		result->data[i] = m->data[i];
+	}
+
+	return true;
+}
+
+constexpr fixed_mat4 fixedOfMat4(mat4 const &m) {
+	fixed_mat4 result = {};
+
+	for(std::size_t i = 0; i < 16; ++i) {
+		result.data[i] = m.data[i];
+	}
+
+	return result;
+}
+
+constexpr mat4 mat4OfFixed(fixed_mat4 const &m) {
+	mat4 result = {};
+
+	for(std::size_t i = 0; i < 16; ++i) {
+		result.data[i] = m.data[i];
+	}
+
+	return result;
+}
+
+constexpr fixed_vec3 fixedOfVec3(vec3 const &v) {
+	fixed_vec3 result = {{v.data[0], v.data[1], v.data[2]}};
+
+	return result;
+}
+
+constexpr vec3 vec3OfFixed(fixed_vec3 const &v) {
+	vec3 result = {{v[0], v[1], v[2]}};
+
+	return result;
+}
+
+constexpr fixed_vec4 fixedOfVec4(vec4 const &v) {
+	fixed_vec4 result = {{v.data[0], v.data[1], v.data[2], v.data[3]}};
+
+	return result;
+}
+
+constexpr vec4 vec4OfFixed(fixed_vec4 const &v) {
+	vec4 result = {{v[0], v[1], v[2], v[3]}};
+
+	return result;
+}
+
+static_assert(sizeof(fixed_mat4) == sizeof(mat4), "fixed_mat4 and mat4 must share a layout");
+
+}
+
+#endif
@@ -0,0 +1,1458 @@
+/*Benchmarks for opengl_math
+ *
+ *Build:	gcc -O2 -o opengl_math_bench opengl_math_bench.c opengl_math.c -lm -lpthread
+ *Run:		./opengl_math_bench [--format=text|csv|json] [--filter=substring] [--min-time=seconds] [--threads=n] [--check]
+ *
+ *Each benchmark is run with a doubling number of iterations until one batch takes at least --min-time seconds (0.2 by default), and
+ *reports the time per operation, the library's heap allocations per operation (see mathAllocationCount) and its throughput.
+ *multMatrix_reference is the original naive multMatrix, kept here so optimised paths can be compared against it
+ *
+ *Before benchmarking, the program checks the library against the reference and fails if any check does:
+ *	- 4x4 products whose result aliases an operand
+ *	- multMatrixParallel across repeatedly created and destroyed thread pools
+ *	- multMatrix, multMatrixInto and multMatrixParallel on shapes that leave partial tiles
+ *	- the LU functions' residuals, and their handling of a singular matrix
+ *	- inverseMat4 and affineInverseMat4 against inverseMatrix and each other, and their handling of a singular matrix
+ *--check stops after that. Building with -DOPENGL_MATH_NO_SIMD checks the scalar kernels, which the SIMD ones otherwise hide:
+ *		gcc -O2 -DOPENGL_MATH_NO_SIMD -o opengl_math_check opengl_math_bench.c opengl_math.c -lm -lpthread && ./opengl_math_check --check*/
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <math.h>
+#include <float.h>
+#include "opengl_math.h"
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <time.h>
+#endif
+
+static double nowSeconds(void) {
+#ifdef _WIN32
+	LARGE_INTEGER frequency, counter;
+	QueryPerformanceFrequency(&frequency);
+	QueryPerformanceCounter(&counter);
+
+	return (double) counter.QuadPart / (double) frequency.QuadPart;
+#else
+	struct timespec t;
+	clock_gettime(CLOCK_MONOTONIC, &t);
+
+	return t.tv_sec + t.tv_nsec * 1e-9;
+#endif
+}
+
+//Keeps results alive so the compiler can't drop the work that produced them
+static volatile float sink;
+
+typedef struct {
+	char name[64];
+	size_t iterations;
+	double ns_per_op;
+	double allocs_per_op;
+	double ops_per_sec;
+	double gflops;	//negative when flops don't make sense for the benchmark
+} bench_result;
+
+#define MAX_RESULTS 128
+
+static bench_result results[MAX_RESULTS];
+static size_t result_count = 0;
+
+static char const *filter = NULL;
+static double min_time = 0.2;
+
+//One benchmark: runs the measured operation iterations times on ctx
+typedef void (*bench_fn)(void *ctx, size_t iterations);
+
+static void runBenchmark(char const *name, bench_fn fn, void *ctx, double flops_per_op) {
+	if((filter != NULL && strstr(name, filter) == NULL) || result_count == MAX_RESULTS) {
+		return;
+	}
+
+	//Warm-up, which also picks the SIMD kernels and sizes any arena before anything is counted
+	fn(ctx, 1);
+
+	size_t iterations = 1;
+	double elapsed;
+	size_t allocations;
+
+	for(;;) {
+		size_t allocations_before = mathAllocationCount();
+		double start = nowSeconds();
+
+		fn(ctx, iterations);
+
+		elapsed = nowSeconds() - start;
+		allocations = mathAllocationCount() - allocations_before;
+
+		if(elapsed >= min_time || iterations >= ((size_t) 1 << 40)) {
+			break;
+		}
+
+		iterations *= 2;
+	}
+
+	bench_result *r = results + result_count++;
+
+	snprintf(r->name, sizeof(r->name), "%s", name);
+	r->iterations = iterations;
+	r->ns_per_op = elapsed * 1e9 / iterations;
+	r->allocs_per_op = (double) allocations / iterations;
+	r->ops_per_sec = iterations / elapsed;
+	r->gflops = (flops_per_op > 0.0 ? flops_per_op * iterations / elapsed * 1e-9 : -1.0);
+
+	fprintf(stderr, "%s done\n", name);
+}
+
+static void printText(void) {
+	printf("%-40s %12s %14s %12s %14s %10s\n", "benchmark", "iterations", "ns/op", "allocs/op", "ops/s", "GFLOP/s");
+
+	size_t i;
+	for(i = 0; i < result_count; ++i) {
+		bench_result *r = results + i;
+
+		printf("%-40s %12lu %14.2f %12.2f %14.0f", r->name, (unsigned long) r->iterations, r->ns_per_op, r->allocs_per_op, r->ops_per_sec);
+
+		if(r->gflops >= 0.0) {
+			printf(" %10.3f\n", r->gflops);
+		} else {
+			printf(" %10s\n", "-");
+		}
+	}
+}
+
+static void printCSV(void) {
+	printf("benchmark,iterations,ns_per_op,allocs_per_op,ops_per_sec,gflops\n");
+
+	size_t i;
+	for(i = 0; i < result_count; ++i) {
+		bench_result *r = results + i;
+
+		printf("%s,%lu,%.3f,%.4f,%.1f,", r->name, (unsigned long) r->iterations, r->ns_per_op, r->allocs_per_op, r->ops_per_sec);
+
+		if(r->gflops >= 0.0) {
+			printf("%.4f", r->gflops);
+		}
+		printf("\n");
+	}
+}
+
+static void printJSON(void) {
+	printf("{\n\t\"threads\": %lu,\n\t\"benchmarks\": [\n", (unsigned long) mathThreadPoolSize() + 1);
+
+	size_t i;
+	for(i = 0; i < result_count; ++i) {
+		bench_result *r = results + i;
+
+		printf("\t\t{\"name\": \"%s\", \"iterations\": %lu, \"ns_per_op\": %.3f, \"allocs_per_op\": %.4f, \"ops_per_sec\": %.1f, \"gflops\": ",
+			   r->name, (unsigned long) r->iterations, r->ns_per_op, r->allocs_per_op, r->ops_per_sec);
+
+		if(r->gflops >= 0.0) {
+			printf("%.4f", r->gflops);
+		} else {
+			printf("null");
+		}
+		printf("}%s\n", (i + 1 < result_count ? "," : ""));
+	}
+
+	printf("\t]\n}\n");
+}
+
+/*Reference implementation
+ *multMatrix as it was before any of the optimised paths, minus the stack VLA (which can't hold the large sizes) - PURE_MULT only*/
+static f_matrix *multMatrixReference(f_matrix *a, f_matrix *b) {
+	f_matrix *result = createMatrix(a->rows, b->cols);
+
+	size_t a_r, b_c, i, shared_dim = a->cols;
+	for(a_r = 0; a_r < a->rows; ++a_r) {
+		for(b_c = 0; b_c < b->cols; ++b_c) {
+			float val = 0.0f;
+
+			for(i = 0; i < shared_dim; ++i) {
+				float v1 = getMatrixValue(a, a_r, i);
+				float v2 = getMatrixValue(b, i, b_c);
+
+				val += (v1 * v2);
+			}
+
+			setMatrixValue(result, a_r, b_c, val);
+		}
+	}
+
+	return result;
+}
+
+/*Aliasing checks
+ *multMat4 and the destructive multMatrix modes write their result over an operand, which the kernels must only do once they've
+ *read all of it. Each case runs a few times in a chain, the way the renderer builds up transforms, so a wrong entry also spoils
+ *the steps after it*/
+#define CHECK_CHAIN 4
+#define CHECK_TOLERANCE 1e-5f
+
+static float maxDifference(float const *a, float const *b, size_t count) {
+	float difference = 0.0f;
+
+	size_t i;
+	for(i = 0; i < count; ++i) {
+		difference = fmaxf(difference, fabsf(a[i] - b[i]));
+	}
+
+	return difference;
+}
+
+//Operands covering the general, affine and translation paths
+static f_matrix *checkOperand(size_t which) {
+	f_matrix *m;
+
+	switch(which) {
+		case 0:
+			return rotateYMatrix(30.0f);
+		case 1:
+			return translationMatrix(1.0f, -2.0f, 0.5f);
+		default:
+			m = createSquareMatrix(4);
+
+			size_t i;
+			for(i = 0; i < 16; ++i) {
+				m->data[i] = (float) ((i * 5) % 11) / 11.0f - 0.3f;
+			}
+
+			return m;
+	}
+}
+
+#define CHECK_OPERANDS 3
+
+//Returns the number of cases that failed
+static int checkAliasedProducts(void) {
+	static MULT_MODE const modes[] = {DESTRUCTIVE_MULT_A, DESTRUCTIVE_MULT_B};
+	static char const * const mode_names[] = {"DESTRUCTIVE_MULT_A", "DESTRUCTIVE_MULT_B"};
+
+	int failures = 0;
+
+	size_t x, y, m, step;
+	for(x = 0; x < CHECK_OPERANDS; ++x) {
+		for(y = 0; y < CHECK_OPERANDS; ++y) {
+			for(m = 0; m < 2; ++m) {
+				f_matrix *a = checkOperand(x);
+				f_matrix *b = checkOperand(y);
+				f_matrix *expected = createSquareMatrix(4);
+				memcpy(expected->data, (modes[m] == DESTRUCTIVE_MULT_A ? a : b)->data, 16 * sizeof(float));
+
+				float difference = 0.0f;
+				for(step = 0; step < CHECK_CHAIN; ++step) {
+					f_matrix *product = multMatrixReference(modes[m] == DESTRUCTIVE_MULT_A ? expected : a, modes[m] == DESTRUCTIVE_MULT_A ? b : expected);
+					memcpy(expected->data, product->data, 16 * sizeof(float));
+					destroyMatrix(product);
+
+					f_matrix *result = multMatrix(a, b, modes[m]);
+					difference = fmaxf(difference, maxDifference(result->data, expected->data, 16));
+				}
+
+				if(difference > CHECK_TOLERANCE) {
+					fprintf(stderr, "multMatrix %s, operands %zu and %zu: off by %g\n", mode_names[m], x, y, difference);
+					++failures;
+				}
+
+				destroyMatrix(a);
+				destroyMatrix(b);
+				destroyMatrix(expected);
+			}
+
+			//The same operands as mat4s, multiplied into each of them in turn
+			f_matrix *a = checkOperand(x);
+			f_matrix *b = checkOperand(y);
+			mat4 ma, mb, expected;
+			memcpy(ma.data, a->data, sizeof(ma.data));
+			memcpy(mb.data, b->data, sizeof(mb.data));
+
+			float difference = 0.0f;
+			for(step = 0; step < CHECK_CHAIN; ++step) {
+				multMat4(&expected, &ma, &mb);
+				multMat4(&ma, &ma, &mb);
+				difference = fmaxf(difference, maxDifference(ma.data, expected.data, 16));
+
+				multMat4(&expected, &ma, &mb);
+				multMat4(&mb, &ma, &mb);
+				difference = fmaxf(difference, maxDifference(mb.data, expected.data, 16));
+			}
+
+			if(difference > CHECK_TOLERANCE) {
+				fprintf(stderr, "multMat4 in place, operands %zu and %zu: off by %g\n", x, y, difference);
+				++failures;
+			}
+
+			destroyMatrix(a);
+			destroyMatrix(b);
+		}
+	}
+
+	return failures;
+}
+
+/*Thread pool restarts
+ *Each round creates a fresh pool, so a worker that carried state over from the previous one would pick up a job that isn't there,
+ *or let multMatrixParallel return while it's still writing the product*/
+#define CHECK_POOL_ROUNDS 32
+#define CHECK_POOL_SIZE 160	//big enough for multMatrixParallel to use the pool
+
+//Returns the number of rounds that failed
+static int checkPoolRestarts(void) {
+	size_t const n = CHECK_POOL_SIZE;
+	f_matrix *a = createSquareMatrix(n);
+	f_matrix *b = createSquareMatrix(n);
+
+	size_t i;
+	for(i = 0; i < n*n; ++i) {
+		a->data[i] = (float) (i % 7) / 7.0f;
+		b->data[i] = (float) (i % 5) / 5.0f - 0.5f;
+	}
+
+	f_matrix *expected = multMatrixReference(a, b);
+
+	int failures = 0;
+
+	size_t round;
+	for(round = 0; round < CHECK_POOL_ROUNDS; ++round) {
+		if(!createMathThreadPool(3)) {
+			fprintf(stderr, "createMathThreadPool failed in round %zu\n", round);
+			++failures;
+
+			continue;
+		}
+
+		f_matrix *result = multMatrixParallel(a, b, PURE_MULT);
+		float const difference = maxDifference(result->data, expected->data, n*n);
+		destroyMatrix(result);
+
+		destroyMathThreadPool();
+
+		if(difference > CHECK_TOLERANCE * n) {
+			fprintf(stderr, "multMatrixParallel after %zu pool restarts: off by %g\n", round, difference);
+			++failures;
+		}
+	}
+
+	destroyMatrix(a);
+	destroyMatrix(b);
+	destroyMatrix(expected);
+
+	return failures;
+}
+
+/*Product shapes
+ *multMatrix, multMatrixInto and multMatrixParallel against the reference, on shapes that leave partial tiles along every dimension of
+ *the blocked multiply, or that are too thin to be blocked at all. Differences are scaled by k * max|a| * max|b|, which bounds the
+ *rounding error of any summation order*/
+#define RESIDUAL_TOLERANCE 1e-6f	//about 16 float epsilons
+
+static float maxAbs(f_matrix *m) {
+	float largest = 0.0f;
+
+	size_t i;
+	for(i = 0; i < m->rows * m->cols; ++i) {
+		largest = fmaxf(largest, fabsf(m->data[i]));
+	}
+
+	return largest;
+}
+
+typedef struct {
+	size_t m, n, k;	//a is m x k, b is k x n
+} check_shape;
+
+static f_matrix *checkProductOperand(size_t rows, size_t cols, unsigned int seed) {
+	f_matrix *m = createMatrix(rows, cols);
+
+	size_t i;
+	for(i = 0; i < rows * cols; ++i) {
+		seed = seed*1103515245u + 12345u;
+		m->data[i] = (float) (seed >> 16 & 0x7FFF) / 0x7FFF - 0.5f;
+	}
+
+	return m;
+}
+
+//Returns the number of functions that got the product wrong
+static int checkProductShape(check_shape const *shape) {
+	f_matrix *a = checkProductOperand(shape->m, shape->k, 1);
+	f_matrix *b = checkProductOperand(shape->k, shape->n, 2);
+	f_matrix *expected = multMatrixReference(a, b);
+	float const scale = shape->k * maxAbs(a) * maxAbs(b);
+
+	static char const * const names[] = {"multMatrix", "multMatrixInto", "multMatrixParallel"};
+	f_matrix *results[3];
+	results[0] = multMatrix(a, b, PURE_MULT);
+	results[1] = multMatrixInto(createMatrix(shape->m, shape->n), a, b, NULL);
+	results[2] = multMatrixParallel(a, b, PURE_MULT);
+
+	int failures = 0;
+
+	size_t i;
+	for(i = 0; i < 3; ++i) {
+		float const difference = maxDifference(results[i]->data, expected->data, shape->m * shape->n) / scale;
+
+		if(difference > RESIDUAL_TOLERANCE) {
+			fprintf(stderr, "%s %zux%zux%zu: off by %g\n", names[i], shape->m, shape->n, shape->k, difference);
+			++failures;
+		}
+
+		destroyMatrix(results[i]);
+	}
+
+	destroyMatrix(a);
+	destroyMatrix(b);
+	destroyMatrix(expected);
+
+	return failures;
+}
+
+static int checkProductShapes(void) {
+	static check_shape const shapes[] = {
+		{1, 1, 1}, {7, 7, 7}, {47, 47, 47}, {48, 48, 48}, {49, 49, 49}, {129, 129, 129}, {257, 257, 257},
+		{1, 257, 7}, {257, 1, 49}, {7, 129, 1}, {47, 49, 48}, {1030, 1031, 300}
+	};
+
+	//Without a pool multMatrixParallel is multMatrix, so one is created for the checks
+	if(!createMathThreadPool(3)) {
+		fprintf(stderr, "createMathThreadPool failed\n");
+
+		return 1;
+	}
+
+	int failures = 0;
+
+	size_t s;
+	for(s = 0; s < sizeof(shapes)/sizeof(*shapes); ++s) {
+		failures += checkProductShape(shapes + s);
+	}
+
+	destroyMathThreadPool();
+
+	return failures;
+}
+
+/*Matrix multiplication
+ *b's entries are all 1/n, so a * b keeps a's row sums and destructive chains stay bounded however long they run*/
+typedef struct {
+	f_matrix *a;
+	f_matrix *b;
+	MULT_MODE mode;
+	int parallel;
+} mult_ctx;
+
+static void fillMultOperands(mult_ctx *ctx, size_t n) {
+	ctx->a = createSquareMatrix(n);
+	ctx->b = createSquareMatrix(n);
+
+	size_t i;
+	for(i = 0; i < n*n; ++i) {
+		ctx->a->data[i] = (float) (i % 7) / 7.0f;
+		ctx->b->data[i] = 1.0f / n;
+	}
+}
+
+static void benchMult(void *p, size_t iterations) {
+	mult_ctx *ctx = p;
+
+	size_t i;
+	for(i = 0; i < iterations; ++i) {
+		f_matrix *r = (ctx->parallel ? multMatrixParallel : multMatrix)(ctx->a, ctx->b, ctx->mode);
+
+		sink = r->data[0];
+
+		if(ctx->mode == PURE_MULT) {
+			destroyMatrix(r);
+		}
+	}
+}
+
+static void benchMultReference(void *p, size_t iterations) {
+	mult_ctx *ctx = p;
+
+	size_t i;
+	for(i = 0; i < iterations; ++i) {
+		f_matrix *r = multMatrixReference(ctx->a, ctx->b);
+
+		sink = r->data[0];
+		destroyMatrix(r);
+	}
+}
+
+static void benchMultMat4(void *p, size_t iterations) {
+	(void) p;
+
+	mat4 a, b;
+	rotateYMat4(&a, 30.0f);
+	rotateXMat4(&b, 1.0f);
+
+	size_t i;
+	for(i = 0; i < iterations; ++i) {
+		multMat4(&a, &a, &b);
+	}
+
+	sink = a.data[0];
+}
+
+static void benchMultSizes(void) {
+	static MULT_MODE const modes[] = {PURE_MULT, DESTRUCTIVE_MULT_A, DESTRUCTIVE_MULT_B};
+	static char const * const mode_names[] = {"pure", "destructive_a", "destructive_b"};
+	static size_t const sizes[] = {4, 16, 64, 256, 1024};
+
+	char name[64];
+	size_t s, m;
+
+	for(s = 0; s < sizeof(sizes)/sizeof(*sizes); ++s) {
+		size_t n = sizes[s];
+		double flops = 2.0 * n * n * n;
+		mult_ctx ctx;
+
+		fillMultOperands(&ctx, n);
+		ctx.parallel = 0;
+
+		for(m = 0; m < 3; ++m) {
+			ctx.mode = modes[m];
+
+			snprintf(name, sizeof(name), "multMatrix_%lu_%s", (unsigned long) n, mode_names[m]);
+			runBenchmark(name, benchMult, &ctx, flops);
+		}
+
+		if(mathThreadPoolSize() > 0) {
+			ctx.mode = PURE_MULT;
+			ctx.parallel = 1;
+
+			snprintf(name, sizeof(name), "multMatrixParallel_%lu_pure", (unsigned long) n);
+			runBenchmark(name, benchMult, &ctx, flops);
+		}
+
+		//The reference takes seconds per call beyond this
+		if(n <= 256) {
+			snprintf(name, sizeof(name), "multMatrix_reference_%lu", (unsigned long) n);
+			runBenchmark(name, benchMultReference, &ctx, flops);
+		}
+
+		destroyMatrix(ctx.a);
+		destroyMatrix(ctx.b);
+	}
+
+	runBenchmark("multMat4", benchMultMat4, NULL, 2.0 * 4 * 4 * 4);
+
+	//Same chain as multMatrix_4_destructive_a, but with both operands tagged as affine by their constructors
+	mult_ctx ctx = {rotateYMatrix(30.0f), rotateXMatrix(1.0f), DESTRUCTIVE_MULT_A, 0};
+	runBenchmark("multMatrix_4_affine", benchMult, &ctx, 2.0 * 4 * 4 * 4);
+	destroyMatrix(ctx.a);
+	destroyMatrix(ctx.b);
+
+	mult_ctx simple = {translationMatrix(1.0f, 2.0f, 3.0f), translationMatrix(0.0f, 0.0f, 0.0f), DESTRUCTIVE_MULT_A, 0};
+	runBenchmark("multMatrix_4_translations", benchMult, &simple, 2.0 * 4 * 4 * 4);
+	destroyMatrix(simple.a);
+	destroyMatrix(simple.b);
+}
+
+/*Linear systems
+ *The matrix is random with a heavy diagonal, so it's well conditioned but still needs some pivoting*/
+typedef struct {
+	f_matrix *m;
+	f_matrix *b;
+} linear_ctx;
+
+static void fillLinearSystem(linear_ctx *ctx, size_t n, size_t rhs) {
+	ctx->m = createSquareMatrix(n);
+	ctx->b = createMatrix(n, rhs);
+
+	unsigned int state = 12345;
+
+	size_t i;
+	for(i = 0; i < n*n; ++i) {
+		state = state*1103515245u + 12345u;
+		ctx->m->data[i] = (float) (state >> 16 & 0x7FFF) / 0x7FFF - 0.5f;
+	}
+	for(i = 0; i < n; i += 2) {
+		ctx->m->data[i*n + i] += 0.25f * n;
+	}
+	for(i = 0; i < n*rhs; ++i) {
+		ctx->b->data[i] = (float) (i % 11) - 5.0f;
+	}
+}
+
+static void benchLU(void *p, size_t iterations) {
+	linear_ctx *ctx = p;
+
+	size_t i;
+	for(i = 0; i < iterations; ++i) {
+		f_lu *lu = createLU(ctx->m);
+
+		sink = lu->lu->data[0];
+		destroyLU(lu);
+	}
+}
+
+static void benchSolve(void *p, size_t iterations) {
+	linear_ctx *ctx = p;
+
+	size_t i;
+	for(i = 0; i < iterations; ++i) {
+		f_matrix *x = solveMatrix(ctx->m, ctx->b);
+
+		sink = x->data[0];
+		destroyMatrix(x);
+	}
+}
+
+static void benchInverseMatrix(void *p, size_t iterations) {
+	linear_ctx *ctx = p;
+
+	size_t i;
+	for(i = 0; i < iterations; ++i) {
+		f_matrix *inverse = inverseMatrix(ctx->m);
+
+		sink = inverse->data[0];
+		destroyMatrix(inverse);
+	}
+}
+
+static void benchLinearSystems(void) {
+	static size_t const sizes[] = {64, 256, 1024, 2048};
+
+	char name[64];
+	size_t s;
+
+	for(s = 0; s < sizeof(sizes)/sizeof(*sizes); ++s) {
+		size_t n = sizes[s];
+		linear_ctx ctx;
+
+		fillLinearSystem(&ctx, n, 1);
+
+		//Factoring takes 2n^3/3 multiply-adds' worth of flops, one solve adds 2n^2 and a whole inverse 2n^3 more
+		snprintf(name, sizeof(name), "createLU_%lu", (unsigned long) n);
+		runBenchmark(name, benchLU, &ctx, 2.0/3.0 * n * n * n);
+
+		snprintf(name, sizeof(name), "solveMatrix_%lu", (unsigned long) n);
+		runBenchmark(name, benchSolve, &ctx, 2.0/3.0 * n * n * n + 2.0 * n * n);
+
+		if(n <= 1024) {
+			snprintf(name, sizeof(name), "inverseMatrix_%lu", (unsigned long) n);
+			runBenchmark(name, benchInverseMatrix, &ctx, 2.0/3.0 * n * n * n + 2.0 * n * n * n);
+		}
+
+		destroyMatrix(ctx.m);
+		destroyMatrix(ctx.b);
+	}
+}
+
+/*Linear system checks
+ *Residuals are scaled by n * max|a| * max|x|, which bounds how far off a backward stable solve can be, so one tolerance covers every
+ *size. The sizes straddle the LU blocking and the edges of the multiply kernels' tiles, and run both without and with a thread pool*/
+//How far a * x is from b, or from the identity when b is NULL
+static float scaledResidual(f_matrix *a, f_matrix *x, f_matrix *b) {
+	f_matrix *product = multMatrixReference(a, x);
+
+	float residual = 0.0f;
+
+	size_t r, c;
+	for(r = 0; r < product->rows; ++r) {
+		for(c = 0; c < product->cols; ++c) {
+			float const target = (b != NULL ? getMatrixValue(b, r, c) : (r == c ? 1.0f : 0.0f));
+			residual = fmaxf(residual, fabsf(getMatrixValue(product, r, c) - target));
+		}
+	}
+
+	destroyMatrix(product);
+
+	return residual / (a->rows * maxAbs(a) * maxAbs(x));
+}
+
+//Gaussian elimination with partial pivoting, in double and unblocked
+static double determinantReference(f_matrix *m) {
+	size_t const n = m->rows;
+	double *a = malloc(n * n * sizeof(double));
+
+	size_t r, c, k;
+	for(r = 0; r < n; ++r) {
+		for(c = 0; c < n; ++c) {
+			a[r*n + c] = getMatrixValue(m, r, c);
+		}
+	}
+
+	double determinant = 1.0;
+	for(k = 0; k < n; ++k) {
+		size_t pivot = k;
+		for(r = k + 1; r < n; ++r) {
+			if(fabs(a[r*n + k]) > fabs(a[pivot*n + k])) {
+				pivot = r;
+			}
+		}
+
+		if(pivot != k) {
+			for(c = 0; c < n; ++c) {
+				double const t = a[k*n + c];
+				a[k*n + c] = a[pivot*n + c];
+				a[pivot*n + c] = t;
+			}
+			determinant = -determinant;
+		}
+
+		determinant *= a[k*n + k];
+		if(a[k*n + k] == 0.0) {
+			break;
+		}
+
+		for(r = k + 1; r < n; ++r) {
+			double const l = a[r*n + k] / a[k*n + k];
+			for(c = k; c < n; ++c) {
+				a[r*n + c] -= l * a[k*n + c];
+			}
+		}
+	}
+
+	free(a);
+
+	return determinant;
+}
+
+#define CHECK_RHS 3
+
+//Returns the number of cases that failed
+static int checkLinearSystem(size_t n) {
+	linear_ctx ctx;
+	fillLinearSystem(&ctx, n, CHECK_RHS);
+
+	int failures = 0;
+
+	f_lu *lu = createLU(ctx.m);
+	f_matrix *x = copyMatrix(ctx.b);
+	if(lu == NULL || !solveLU(lu, x)) {
+		fprintf(stderr, "createLU/solveLU %zu: failed\n", n);
+		++failures;
+	} else if(scaledResidual(ctx.m, x, ctx.b) > RESIDUAL_TOLERANCE) {
+		fprintf(stderr, "createLU/solveLU %zu: residual %g\n", n, scaledResidual(ctx.m, x, ctx.b));
+		++failures;
+	}
+	destroyMatrix(x);
+	if(lu != NULL) {
+		destroyLU(lu);
+	}
+
+	x = solveMatrix(ctx.m, ctx.b);
+	if(x == NULL) {
+		fprintf(stderr, "solveMatrix %zu: failed\n", n);
+		++failures;
+	} else {
+		if(scaledResidual(ctx.m, x, ctx.b) > RESIDUAL_TOLERANCE) {
+			fprintf(stderr, "solveMatrix %zu: residual %g\n", n, scaledResidual(ctx.m, x, ctx.b));
+			++failures;
+		}
+		destroyMatrix(x);
+	}
+
+	f_matrix *inverse = inverseMatrix(ctx.m);
+	if(inverse == NULL) {
+		fprintf(stderr, "inverseMatrix %zu: failed\n", n);
+		++failures;
+	} else {
+		if(scaledResidual(ctx.m, inverse, NULL) > RESIDUAL_TOLERANCE) {
+			fprintf(stderr, "inverseMatrix %zu: residual %g\n", n, scaledResidual(ctx.m, inverse, NULL));
+			++failures;
+		}
+		destroyMatrix(inverse);
+	}
+
+	//Past a few dozen rows the heavy diagonal takes the determinant out of a float's range, which the header allows for
+	double const expected = determinantReference(ctx.m);
+	float const determinant = matrixDeterminant(ctx.m);
+	if(fabs(expected) < FLT_MAX && fabs(determinant - expected) > CHECK_TOLERANCE * n * fabs(expected)) {
+		fprintf(stderr, "matrixDeterminant %zu: %g instead of %g\n", n, determinant, expected);
+		++failures;
+	}
+
+	destroyMatrix(ctx.m);
+	destroyMatrix(ctx.b);
+
+	return failures;
+}
+
+//A zero column keeps an exact zero on U's diagonal however the elimination is ordered
+static int checkSingularSystem(size_t n) {
+	linear_ctx ctx;
+	fillLinearSystem(&ctx, n, CHECK_RHS);
+
+	size_t r;
+	for(r = 0; r < n; ++r) {
+		setMatrixValue(ctx.m, r, n / 2, 0.0f);
+	}
+
+	int failures = 0;
+
+	f_lu *lu = createLU(ctx.m);
+	f_matrix *x = copyMatrix(ctx.b);
+	if(lu == NULL || !isSingularLU(lu) || solveLU(lu, x) || memcmp(x->data, ctx.b->data, n * CHECK_RHS * sizeof(float)) != 0) {
+		fprintf(stderr, "createLU/solveLU %zu: singular matrix not rejected\n", n);
+		++failures;
+	}
+	destroyMatrix(x);
+	if(lu != NULL) {
+		destroyLU(lu);
+	}
+
+	x = solveMatrix(ctx.m, ctx.b);
+	if(x != NULL) {
+		fprintf(stderr, "solveMatrix %zu: singular matrix not rejected\n", n);
+		destroyMatrix(x);
+		++failures;
+	}
+
+	f_matrix *inverse = inverseMatrix(ctx.m);
+	if(inverse != NULL) {
+		fprintf(stderr, "inverseMatrix %zu: singular matrix not rejected\n", n);
+		destroyMatrix(inverse);
+		++failures;
+	}
+
+	if(matrixDeterminant(ctx.m) != 0.0f) {
+		fprintf(stderr, "matrixDeterminant %zu: %g for a singular matrix\n", n, matrixDeterminant(ctx.m));
+		++failures;
+	}
+
+	destroyMatrix(ctx.m);
+	destroyMatrix(ctx.b);
+
+	return failures;
+}
+
+static int checkLinearSystems(void) {
+	static size_t const sizes[] = {1, 16, 17, 32, 33, 65, 257};
+
+	int failures = 0;
+
+	size_t pooled, s;
+	for(pooled = 0; pooled < 2; ++pooled) {
+		if(pooled && !createMathThreadPool(3)) {
+			fprintf(stderr, "createMathThreadPool failed\n");
+
+			return failures + 1;
+		}
+
+		for(s = 0; s < sizeof(sizes)/sizeof(*sizes); ++s) {
+			failures += checkLinearSystem(sizes[s]) + checkSingularSystem(sizes[s]);
+		}
+
+		if(pooled) {
+			destroyMathThreadPool();
+		}
+	}
+
+	return failures;
+}
+
+/*4x4 inverse checks
+ *inverseMat4 is compared against inverseMatrix, whose LU path the checks above cover, and affineInverseMat4 against both on
+ *translation * rotation * scale matrices. The bench can't reach the scalar inverseMat4 kernel on x86, but a -DOPENGL_MATH_NO_SIMD
+ *build runs the same checks on it. Singular input must return 0 and leave the result alone*/
+#define CHECK_INVERSE_SENTINEL 12345.0f
+
+static float mat4MaxAbs(mat4 const *m) {
+	float largest = 0.0f;
+
+	size_t i;
+	for(i = 0; i < 16; ++i) {
+		largest = fmaxf(largest, fabsf(m->data[i]));
+	}
+
+	return largest;
+}
+
+//max|m * inverse - I|, scaled like scaledResidual
+static float mat4Residual(mat4 const *m, mat4 const *inverse) {
+	mat4 product;
+	multMat4(&product, m, inverse);
+
+	float residual = 0.0f;
+
+	size_t i;
+	for(i = 0; i < 16; ++i) {
+		residual = fmaxf(residual, fabsf(product.data[i] - (i % 5 == 0 ? 1.0f : 0.0f)));
+	}
+
+	return residual / (4.0f * mat4MaxAbs(m) * mat4MaxAbs(inverse));
+}
+
+//Returns the number of ways inverse got m wrong
+static int checkInverse(char const *name, int (*inverse)(mat4 *, mat4 const *), mat4 *m, size_t which) {
+	mat4 result;
+	if(!inverse(&result, m)) {
+		fprintf(stderr, "%s, matrix %zu: rejected an invertible matrix\n", name, which);
+
+		return 1;
+	}
+
+	int failures = 0;
+
+	if(mat4Residual(m, &result) > RESIDUAL_TOLERANCE) {
+		fprintf(stderr, "%s, matrix %zu: residual %g\n", name, which, mat4Residual(m, &result));
+		++failures;
+	}
+
+	f_matrix view = matrixOfMat4(m);
+	f_matrix *expected = inverseMatrix(&view);
+	float const difference = maxDifference(result.data, expected->data, 16) / maxAbs(expected);
+	destroyMatrix(expected);
+
+	if(difference > CHECK_TOLERANCE) {
+		fprintf(stderr, "%s, matrix %zu: off from inverseMatrix by %g\n", name, which, difference);
+		++failures;
+	}
+
+	return failures;
+}
+
+static int checkSingularInverse(char const *name, int (*inverse)(mat4 *, mat4 const *), mat4 *m, size_t which) {
+	mat4 result;
+
+	size_t i;
+	for(i = 0; i < 16; ++i) {
+		result.data[i] = CHECK_INVERSE_SENTINEL;
+	}
+
+	int const accepted = inverse(&result, m);
+
+	for(i = 0; i < 16 && result.data[i] == CHECK_INVERSE_SENTINEL; ++i);
+
+	if(accepted || i < 16) {
+		fprintf(stderr, "%s, singular matrix %zu: %s\n", name, which, (accepted ? "not rejected" : "result overwritten"));
+
+		return 1;
+	}
+
+	return 0;
+}
+
+#define CHECK_TRS 4
+
+static void checkTRS(mat4 *m, size_t which, int singular) {
+	static float const transforms[CHECK_TRS][7] = {
+		//translation, Euler angles in degrees, then a scale factor the axes share in different proportions
+		{0.0f, 0.0f, 0.0f, 0.0f, 0.0f, 0.0f, 1.0f},
+		{1.0f, -2.0f, 0.5f, 30.0f, 0.0f, 0.0f, 2.0f},
+		{-5.0f, 3.0f, 10.0f, 10.0f, -70.0f, 45.0f, 0.5f},
+		{100.0f, 0.25f, -40.0f, 170.0f, 35.0f, -120.0f, 3.0f}
+	};
+	float const *t = transforms[which];
+
+	vec3 translation, scale;
+	quat rotation;
+	setVec3(&translation, t[0], t[1], t[2]);
+	eulerQuat(&rotation, t[3], t[4], t[5]);
+	setVec3(&scale, t[6], (singular ? 0.0f : 1.0f), 1.0f / t[6] + 0.5f);
+
+	trsMat4(m, &translation, &rotation, &scale);
+}
+
+//Returns the number of cases that failed
+static int checkInverses(void) {
+	int failures = 0;
+	mat4 m;
+
+	size_t which, i;
+	for(which = 0; which < CHECK_OPERANDS; ++which) {
+		f_matrix *operand = checkOperand(which);
+		memcpy(m.data, operand->data, sizeof(m.data));
+		destroyMatrix(operand);
+
+		failures += checkInverse("inverseMat4", inverseMat4, &m, which);
+	}
+
+	//Well conditioned, with no structure to it
+	unsigned int seed = 3;
+	for(i = 0; i < 16; ++i) {
+		seed = seed*1103515245u + 12345u;
+		m.data[i] = (float) (seed >> 16 & 0x7FFF) / 0x7FFF - 0.5f + (i % 5 == 0 ? 2.0f : 0.0f);
+	}
+	failures += checkInverse("inverseMat4", inverseMat4, &m, CHECK_OPERANDS);
+
+	for(which = 0; which < CHECK_TRS; ++which) {
+		checkTRS(&m, which, 0);
+
+		failures += checkInverse("inverseMat4 of a TRS", inverseMat4, &m, which);
+		failures += checkInverse("affineInverseMat4", affineInverseMat4, &m, which);
+
+		mat4 general, affine;
+		inverseMat4(&general, &m);
+		affineInverseMat4(&affine, &m);
+
+		float const difference = maxDifference(general.data, affine.data, 16) / mat4MaxAbs(&affine);
+		if(difference > CHECK_TOLERANCE) {
+			fprintf(stderr, "inverseMat4 and affineInverseMat4, matrix %zu: %g apart\n", which, difference);
+			++failures;
+		}
+
+		//Flattening one axis leaves an exact zero column
+		checkTRS(&m, which, 1);
+
+		failures += checkSingularInverse("inverseMat4", inverseMat4, &m, which);
+		failures += checkSingularInverse("affineInverseMat4", affineInverseMat4, &m, which);
+		failures += checkSingularInverse("inverseTransposeMat4", inverseTransposeMat4, &m, which);
+	}
+
+	memset(m.data, 0, sizeof(m.data));
+	failures += checkSingularInverse("inverseMat4", inverseMat4, &m, CHECK_TRS);
+
+	return failures;
+}
+
+/*Constructors*/
+static void benchTranslationMatrix(void *p, size_t iterations) {
+	(void) p;
+
+	size_t i;
+	for(i = 0; i < iterations; ++i) {
+		f_matrix *m = translationMatrix(i, 1.0f, 2.0f);
+
+		sink = m->data[12];
+		destroyMatrix(m);
+	}
+}
+
+static void benchScaleMatrix(void *p, size_t iterations) {
+	(void) p;
+
+	size_t i;
+	for(i = 0; i < iterations; ++i) {
+		f_matrix *m = scaleMatrix(i);
+
+		sink = m->data[0];
+		destroyMatrix(m);
+	}
+}
+
+static void benchRotateMatrix(void *p, size_t iterations) {
+	f_matrix *(*rotate)(float) = *(f_matrix *(**)(float)) p;
+
+	size_t i;
+	for(i = 0; i < iterations; ++i) {
+		f_matrix *m = rotate(i % 360);
+
+		sink = m->data[5];
+		destroyMatrix(m);
+	}
+}
+
+static void benchTranslationMat4(void *p, size_t iterations) {
+	(void) p;
+
+	mat4 m;
+
+	size_t i;
+	for(i = 0; i < iterations; ++i) {
+		translationMat4(&m, i, 1.0f, 2.0f);
+		sink = m.data[12];
+	}
+}
+
+static void benchRotateMat4(void *p, size_t iterations) {
+	(void) p;
+
+	mat4 m;
+
+	size_t i;
+	for(i = 0; i < iterations; ++i) {
+		rotateYMat4(&m, i % 360);
+		sink = m.data[0];
+	}
+}
+
+//A full transform the way it has to be done with f_matrix: five constructors and four products
+static void benchTRSComposed(void *p, size_t iterations) {
+	(void) p;
+
+	size_t i;
+	for(i = 0; i < iterations; ++i) {
+		float angle = i % 360;
+
+		f_matrix *m = translationMatrix(1.0f, 2.0f, 3.0f);
+		f_matrix *r = rotateZMatrix(angle);
+		multMatrix(m, r, DESTRUCTIVE_MULT_A);
+		destroyMatrix(r);
+
+		r = rotateYMatrix(angle);
+		multMatrix(m, r, DESTRUCTIVE_MULT_A);
+		destroyMatrix(r);
+
+		r = rotateXMatrix(angle);
+		multMatrix(m, r, DESTRUCTIVE_MULT_A);
+		destroyMatrix(r);
+
+		r = scaleMatrix(2.0f);
+		multMatrix(m, r, DESTRUCTIVE_MULT_A);
+		destroyMatrix(r);
+
+		sink = m->data[0];
+		destroyMatrix(m);
+	}
+}
+
+static void benchTRSMat4(void *p, size_t iterations) {
+	(void) p;
+
+	vec3 translation, scale;
+	setVec3(&translation, 1.0f, 2.0f, 3.0f);
+	setVec3(&scale, 2.0f, 2.0f, 2.0f);
+
+	mat4 m;
+	quat q;
+
+	size_t i;
+	for(i = 0; i < iterations; ++i) {
+		float angle = i % 360;
+
+		eulerQuat(&q, angle, angle, angle);
+		trsMat4(&m, &translation, &q, &scale);
+		sink = m.data[0];
+	}
+}
+
+static void benchLookAt(void *p, size_t iterations) {
+	(void) p;
+
+	f_vec *eye = createVec(3), *at = createVec(3), *up = createVec(3);
+	setVecValue(eye, 2, 1.0f);
+	setVecValue(up, 1, 1.0f);
+
+	size_t i;
+	for(i = 0; i < iterations; ++i) {
+		setVecValue(eye, 0, (i % 100) * 0.01f);
+
+		f_matrix *m = lookAt(eye, at, up);
+
+		sink = m->data[0];
+		destroyMatrix(m);
+	}
+
+	destroyVec(eye);
+	destroyVec(at);
+	destroyVec(up);
+}
+
+static void benchLookAtMat4(void *p, size_t iterations) {
+	(void) p;
+
+	vec3 eye, at, up;
+	setVec3(&eye, 0.0f, 0.0f, 1.0f);
+	setVec3(&at, 0.0f, 0.0f, 0.0f);
+	setVec3(&up, 0.0f, 1.0f, 0.0f);
+
+	mat4 m;
+
+	size_t i;
+	for(i = 0; i < iterations; ++i) {
+		eye.data[0] = (i % 100) * 0.01f;
+
+		lookAtMat4(&m, &eye, &at, &up);
+		sink = m.data[0];
+	}
+}
+
+//lookAt with every temporary coming from an arena that's reset after each call, as a renderer would at the end of a frame
+static void benchLookAtArena(void *p, size_t iterations) {
+	f_arena *arena = p;
+
+	f_vec *eye = createVec(3), *at = createVec(3), *up = createVec(3);
+	setVecValue(eye, 2, 1.0f);
+	setVecValue(up, 1, 1.0f);
+
+	size_t i;
+	for(i = 0; i < iterations; ++i) {
+		setVecValue(eye, 0, (i % 100) * 0.01f);
+
+		f_arena *previous = useArena(arena);
+		f_matrix *m = lookAt(eye, at, up);
+		useArena(previous);
+
+		sink = m->data[0];
+		resetArena(arena);
+	}
+
+	destroyVec(eye);
+	destroyVec(at);
+	destroyVec(up);
+}
+
+static void benchOrtho(void *p, size_t iterations) {
+	(void) p;
+
+	size_t i;
+	for(i = 0; i < iterations; ++i) {
+		f_matrix *m = ortho(-1.0f - (i % 10), 1.0f, -1.0f, 1.0f, 0.0f, 2.0f);
+
+		sink = m->data[0];
+		destroyMatrix(m);
+	}
+}
+
+static void benchOrthoMat4(void *p, size_t iterations) {
+	(void) p;
+
+	mat4 m;
+
+	size_t i;
+	for(i = 0; i < iterations; ++i) {
+		orthoMat4(&m, -1.0f - (i % 10), 1.0f, -1.0f, 1.0f, 0.0f, 2.0f);
+		sink = m.data[0];
+	}
+}
+
+//p points to an int (*)(mat4 *, mat4 const *), run on a view matrix as lookAt builds them
+static void benchInverse(void *p, size_t iterations) {
+	int (*invert)(mat4 *, mat4 const *) = *(int (**)(mat4 *, mat4 const *)) p;
+
+	vec3 eye, at, up;
+	setVec3(&eye, 1.0f, 2.0f, 3.0f);
+	setVec3(&at, 0.0f, 0.0f, 0.0f);
+	setVec3(&up, 0.0f, 1.0f, 0.0f);
+
+	mat4 view, inverse;
+	lookAtMat4(&view, &eye, &at, &up);
+
+	size_t i;
+	for(i = 0; i < iterations; ++i) {
+		view.data[12] = i;
+		invert(&inverse, &view);
+		sink = inverse.data[12];
+	}
+}
+
+static void benchConstructors(void) {
+	static f_matrix *(* const rotations[])(float) = {rotateXMatrix, rotateYMatrix, rotateZMatrix};
+	static char const * const rotation_names[] = {"rotateXMatrix", "rotateYMatrix", "rotateZMatrix"};
+
+	runBenchmark("translationMatrix", benchTranslationMatrix, NULL, 0.0);
+	runBenchmark("scaleMatrix", benchScaleMatrix, NULL, 0.0);
+
+	size_t i;
+	for(i = 0; i < 3; ++i) {
+		f_matrix *(*rotate)(float) = rotations[i];
+
+		runBenchmark(rotation_names[i], benchRotateMatrix, &rotate, 0.0);
+	}
+
+	runBenchmark("translationMat4", benchTranslationMat4, NULL, 0.0);
+	runBenchmark("rotateYMat4", benchRotateMat4, NULL, 0.0);
+
+	runBenchmark("trs_composed", benchTRSComposed, NULL, 0.0);
+	runBenchmark("trsMat4_euler", benchTRSMat4, NULL, 0.0);
+
+	runBenchmark("lookAt", benchLookAt, NULL, 0.0);
+	runBenchmark("lookAtMat4", benchLookAtMat4, NULL, 0.0);
+
+	f_arena *arena = createArena(4096);
+	runBenchmark("lookAt_arena", benchLookAtArena, arena, 0.0);
+	destroyArena(arena);
+
+	runBenchmark("ortho", benchOrtho, NULL, 0.0);
+	runBenchmark("orthoMat4", benchOrthoMat4, NULL, 0.0);
+
+	static int (* const inverses[])(mat4 *, mat4 const *) = {inverseMat4, affineInverseMat4, inverseTransposeMat4};
+	static char const * const inverse_names[] = {"inverseMat4", "affineInverseMat4", "inverseTransposeMat4"};
+
+	for(i = 0; i < 3; ++i) {
+		int (*invert)(mat4 *, mat4 const *) = inverses[i];
+
+		runBenchmark(inverse_names[i], benchInverse, &invert, 0.0);
+	}
+}
+
+/*Vector operations*/
+typedef struct {
+	f_vec *a;
+	f_vec *b;
+} vec_ctx;
+
+static void benchSubtractVec(void *p, size_t iterations) {
+	vec_ctx *ctx = p;
+
+	size_t i;
+	for(i = 0; i < iterations; ++i) {
+		f_vec *v = subtractVec(ctx->a, ctx->b);
+
+		sink = v->data[0];
+		destroyVec(v);
+	}
+}
+
+static void benchCrossProduct(void *p, size_t iterations) {
+	vec_ctx *ctx = p;
+
+	size_t i;
+	for(i = 0; i < iterations; ++i) {
+		f_vec *v = crossProduct(ctx->a, ctx->b);
+
+		sink = v->data[0];
+		destroyVec(v);
+	}
+}
+
+static void benchDotProduct(void *p, size_t iterations) {
+	vec_ctx *ctx = p;
+
+	float total = 0.0f;
+
+	size_t i;
+	for(i = 0; i < iterations; ++i) {
+		setVecValue(ctx->a, 0, (float) (i % 3));
+		total += dotProduct(ctx->a, ctx->b);
+	}
+
+	sink = total;
+}
+
+static void benchNormalizeVec(void *p, size_t iterations) {
+	vec_ctx *ctx = p;
+
+	size_t i;
+	for(i = 0; i < iterations; ++i) {
+		f_vec *v = normalizeVec(ctx->a);
+
+		sink = v->data[0];
+		destroyVec(v);
+	}
+}
+
+static void benchVec3(void *p, size_t iterations) {
+	(void) p;
+
+	vec3 a, b, r;
+	setVec3(&a, 1.0f, 2.0f, 3.0f);
+	setVec3(&b, -2.0f, 0.5f, 1.0f);
+
+	size_t i;
+	for(i = 0; i < iterations; ++i) {
+		a.data[0] = (float) (i % 3) + 1.0f;
+
+		subtractVec3(&r, &a, &b);
+		crossProductVec3(&r, &r, &b);
+		normalizeVec3(&r, &r);
+		sink = dotProductVec3(&r, &a);
+	}
+}
+
+typedef struct {
+	float *xyz;
+	size_t count;
+} points_ctx;
+
+static void benchTransformPoints(void *p, size_t iterations) {
+	points_ctx *ctx = p;
+
+	mat4 m;
+	rotateYMat4(&m, 0.5f);
+
+	size_t i;
+	for(i = 0; i < iterations; ++i) {
+		transformPoints(&m, ctx->xyz, ctx->xyz, ctx->count);
+	}
+
+	sink = ctx->xyz[0];
+}
+
+static void benchVectors(void) {
+	vec_ctx ctx;
+	ctx.a = createVec(3);
+	ctx.b = createVec(3);
+
+	setVecValue(ctx.a, 0, 1.0f);
+	setVecValue(ctx.a, 1, 2.0f);
+	setVecValue(ctx.a, 2, 3.0f);
+	setVecValue(ctx.b, 0, -2.0f);
+	setVecValue(ctx.b, 1, 0.5f);
+	setVecValue(ctx.b, 2, 1.0f);
+
+	runBenchmark("subtractVec", benchSubtractVec, &ctx, 0.0);
+	runBenchmark("crossProduct", benchCrossProduct, &ctx, 0.0);
+	runBenchmark("dotProduct", benchDotProduct, &ctx, 0.0);
+	runBenchmark("normalizeVec", benchNormalizeVec, &ctx, 0.0);
+	runBenchmark("vec3_chain", benchVec3, NULL, 0.0);
+
+	destroyVec(ctx.a);
+	destroyVec(ctx.b);
+
+	//Per call, transforming 4096 points costs 9 multiplies and 9 adds each
+	points_ctx points;
+	points.count = 4096;
+	points.xyz = malloc(points.count * 3 * sizeof(float));
+
+	size_t i;
+	for(i = 0; i < points.count * 3; ++i) {
+		points.xyz[i] = (float) (i % 17) * 0.1f;
+	}
+
+	runBenchmark("transformPoints_4096", benchTransformPoints, &points, 18.0 * points.count);
+
+	free(points.xyz);
+}
+
+int main(int argc, char **argv) {
+	char const *format = "text";
+	size_t threads = 0;
+	int check_only = 0;
+
+	int i;
+	for(i = 1; i < argc; ++i) {
+		if(strncmp(argv[i], "--format=", 9) == 0) {
+			format = argv[i] + 9;
+		} else if(strncmp(argv[i], "--filter=", 9) == 0) {
+			filter = argv[i] + 9;
+		} else if(strncmp(argv[i], "--min-time=", 11) == 0) {
+			min_time = atof(argv[i] + 11);
+		} else if(strncmp(argv[i], "--threads=", 10) == 0) {
+			threads = strtoul(argv[i] + 10, NULL, 10);
+		} else if(strcmp(argv[i], "--check") == 0) {
+			check_only = 1;
+		} else {
+			fprintf(stderr, "Usage: %s [--format=text|csv|json] [--filter=substring] [--min-time=seconds] [--threads=n] [--check]\n", argv[0]);
+
+			return 1;
+		}
+	}
+
+	if(strcmp(format, "text") != 0 && strcmp(format, "csv") != 0 && strcmp(format, "json") != 0) {
+		fprintf(stderr, "Unknown format %s\n", format);
+
+		return 1;
+	}
+
+	int const failures = checkAliasedProducts() + checkPoolRestarts() + checkProductShapes() + checkLinearSystems() + checkInverses();
+	if(failures > 0) {
+		fprintf(stderr, "%d checks failed\n", failures);
+
+		return 1;
+	}
+
+	if(check_only) {
+		printf("All checks passed\n");
+
+		return 0;
+	}
+
+	//Workers besides the main thread; only multMatrixParallel and the linear systems use them
+	if(threads > 1) {
+		createMathThreadPool(threads - 1);
+	}
+
+	benchMultSizes();
+	benchLinearSystems();
+	benchConstructors();
+	benchVectors();
+
+	if(strcmp(format, "csv") == 0) {
+		printCSV();
+	} else if(strcmp(format, "json") == 0) {
+		printJSON();
+	} else {
+		printText();
+	}
+
+	destroyMathThreadPool();
+
+	return 0;
+}
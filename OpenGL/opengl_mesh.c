@@ -0,0 +1,1496 @@
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <float.h>
+#include <math.h>
+#include "opengl_mesh.h"
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+static void setError(char const **error, char const *message) {
+	if(error != NULL) {
+		*error = message;
+	}
+}
+
+static uint64_t roundUp64(uint64_t a, uint64_t multiple) {
+	return (a + multiple - 1) / multiple * multiple;
+}
+
+/*File mapping
+ *Read-only and private; the mapping stays valid after the file is closed, until unmapFile*/
+static void *mapFile(char const *path, size_t *size, void **handle, char const **error) {
+#ifdef _WIN32
+	HANDLE file = CreateFileA(path, GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, NULL);
+	if(file == INVALID_HANDLE_VALUE) {
+		setError(error, "couldn't open the file");
+
+		return NULL;
+	}
+
+	LARGE_INTEGER file_size;
+	if(!GetFileSizeEx(file, &file_size) || (uint64_t) file_size.QuadPart < sizeof(mesh_file_header) || (uint64_t) file_size.QuadPart > SIZE_MAX) {
+		CloseHandle(file);
+		setError(error, "not a mesh file (too short)");
+
+		return NULL;
+	}
+
+	HANDLE mapping = CreateFileMappingA(file, NULL, PAGE_READONLY, 0, 0, NULL);
+	CloseHandle(file);
+
+	if(mapping == NULL) {
+		setError(error, "couldn't map the file");
+
+		return NULL;
+	}
+
+	void *data = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+	if(data == NULL) {
+		CloseHandle(mapping);
+		setError(error, "couldn't map the file");
+
+		return NULL;
+	}
+
+	*size = (size_t) file_size.QuadPart;
+	*handle = mapping;
+
+	return data;
+#else
+	int file = open(path, O_RDONLY);
+	if(file < 0) {
+		setError(error, "couldn't open the file");
+
+		return NULL;
+	}
+
+	struct stat status;
+	if(fstat(file, &status) != 0 || (uint64_t) status.st_size < sizeof(mesh_file_header) || (uint64_t) status.st_size > SIZE_MAX) {
+		close(file);
+		setError(error, "not a mesh file (too short)");
+
+		return NULL;
+	}
+
+	void *data = mmap(NULL, (size_t) status.st_size, PROT_READ, MAP_PRIVATE, file, 0);
+	close(file);
+
+	if(data == MAP_FAILED) {
+		setError(error, "couldn't map the file");
+
+		return NULL;
+	}
+
+	//Everything is read front to back, once, on its way to the GPU
+	posix_madvise(data, (size_t) status.st_size, POSIX_MADV_SEQUENTIAL);
+
+	*size = (size_t) status.st_size;
+	*handle = NULL;
+
+	return data;
+#endif
+}
+
+static void unmapFile(void *data, size_t size, void *handle) {
+#ifdef _WIN32
+	(void) size;
+
+	UnmapViewOfFile(data);
+	CloseHandle((HANDLE) handle);
+#else
+	(void) handle;
+
+	munmap(data, size);
+#endif
+}
+
+//Whether bytes bytes from offset lie inside a file of size bytes, without overflowing
+static int rangeFits(uint64_t offset, uint64_t bytes, uint64_t size) {
+	return offset <= size && bytes <= size - offset;
+}
+
+static uint32_t largestIndex(void const *indices, size_t count, size_t index_size) {
+	uint32_t largest = 0;
+
+	size_t i;
+	switch(index_size) {
+		case 1:
+			for(i = 0; i < count; ++i) {
+				uint32_t index = ((uint8_t const *) indices)[i];
+				largest = (index > largest ? index : largest);
+			}
+
+			break;
+		case 2:
+			for(i = 0; i < count; ++i) {
+				uint32_t index = ((uint16_t const *) indices)[i];
+				largest = (index > largest ? index : largest);
+			}
+
+			break;
+		default:
+			for(i = 0; i < count; ++i) {
+				uint32_t index = ((uint32_t const *) indices)[i];
+				largest = (index > largest ? index : largest);
+			}
+	}
+
+	return largest;
+}
+
+//Fills m from the mapped file at data, returning 0 (with *error set) if anything in it doesn't add up
+static int readMeshFile(mesh *m, unsigned char const *data, uint64_t size, char const **error) {
+	mesh_file_header const *header = (mesh_file_header const *) data;
+
+	if(memcmp(header->magic, MESH_MAGIC, 4) != 0) {
+		setError(error, "not a mesh file");
+
+		return 0;
+	}
+
+	if(header->version != MESH_VERSION) {
+		setError(error, "unsupported mesh file version");
+
+		return 0;
+	}
+
+	if(header->index_size != 1 && header->index_size != 2 && header->index_size != 4) {
+		setError(error, "bad index size");
+
+		return 0;
+	}
+
+	if(header->stream_count > MESH_MAX_STREAMS) {
+		setError(error, "too many vertex streams");
+
+		return 0;
+	}
+
+	uint64_t tables = (uint64_t) header->stream_count * sizeof(mesh_file_stream) + (uint64_t) header->part_count * sizeof(mesh_part);
+	if(!rangeFits(sizeof(mesh_file_header), tables, size)) {
+		setError(error, "truncated mesh file");
+
+		return 0;
+	}
+
+	mesh_file_stream const *streams = (mesh_file_stream const *) (data + sizeof(mesh_file_header));
+	mesh_part const *parts = (mesh_part const *) (streams + header->stream_count);
+
+	m->vertex_count = header->vertex_count;
+	m->stream_count = header->stream_count;
+
+	size_t i;
+	for(i = 0; i < m->stream_count; ++i) {
+		mesh_file_stream const *stream = streams + i;
+
+		if(stream->attribute > MESH_COLOR || stream->components < 1 || stream->components > 4 || stream->offset % sizeof(float) != 0) {
+			setError(error, "bad vertex stream");
+
+			return 0;
+		}
+
+		if(!rangeFits(stream->offset, (uint64_t) header->vertex_count * stream->components * sizeof(float), size)) {
+			setError(error, "truncated mesh file");
+
+			return 0;
+		}
+
+		m->streams[i].attribute = (MESH_ATTRIBUTE) stream->attribute;
+		m->streams[i].components = stream->components;
+		m->streams[i].data = (float const *) (data + stream->offset);
+	}
+
+	if(header->index_offset % header->index_size != 0 || !rangeFits(header->index_offset, (uint64_t) header->index_count * header->index_size, size)) {
+		setError(error, "truncated mesh file");
+
+		return 0;
+	}
+
+	m->index_count = header->index_count;
+	m->index_size = header->index_size;
+	m->indices = data + header->index_offset;
+
+	for(i = 0; i < header->part_count; ++i) {
+		if(parts[i].mode > MESH_TRIANGLE_FAN || parts[i].first > header->index_count || parts[i].count > header->index_count - parts[i].first) {
+			setError(error, "bad part");
+
+			return 0;
+		}
+	}
+
+	m->part_count = header->part_count;
+	m->parts = parts;
+
+	//Indices go to the GPU as they are, where one past the end of the vertices isn't caught
+	if(m->index_count > 0 && largestIndex(m->indices, m->index_count, m->index_size) >= m->vertex_count) {
+		setError(error, "index out of range");
+
+		return 0;
+	}
+
+	memcpy(m->bounds_min, header->bounds_min, sizeof(m->bounds_min));
+	memcpy(m->bounds_max, header->bounds_max, sizeof(m->bounds_max));
+
+	return 1;
+}
+
+mesh *openMesh(char const *path, char const **error) {
+	mesh *m = calloc(1, sizeof(mesh));
+	if(m == NULL) {
+		setError(error, "out of memory");
+
+		return NULL;
+	}
+
+	m->storage = mapFile(path, &m->storage_size, &m->mapping_handle, error);
+	if(m->storage == NULL) {
+		free(m);
+
+		return NULL;
+	}
+
+	m->mapped = 1;
+
+	if(!readMeshFile(m, m->storage, m->storage_size, error)) {
+		closeMesh(m);
+
+		return NULL;
+	}
+
+	return m;
+}
+
+void closeMesh(mesh *m) {
+	if(m == NULL) {
+		return;
+	}
+
+	if(m->mapped) {
+		unmapFile(m->storage, m->storage_size, m->mapping_handle);
+	} else {
+		free(m->storage);
+	}
+
+	free(m);
+}
+
+size_t meshIndexSize(size_t vertex_count) {
+	if(vertex_count <= 0x100) {
+		return 1;
+	}
+
+	if(vertex_count <= 0x10000) {
+		return 2;
+	}
+
+	return 4;
+}
+
+uint32_t meshIndex(mesh const *m, size_t i) {
+	switch(m->index_size) {
+		case 1:
+			return ((uint8_t const *) m->indices)[i];
+		case 2:
+			return ((uint16_t const *) m->indices)[i];
+		default:
+			return ((uint32_t const *) m->indices)[i];
+	}
+}
+
+/*Writing*/
+static int writeAt(FILE *file, uint64_t *position, uint64_t offset, void const *data, size_t bytes) {
+	static unsigned char const padding[MESH_ALIGNMENT] = {0};
+
+	while(*position < offset) {
+		size_t gap = (offset - *position < MESH_ALIGNMENT ? (size_t) (offset - *position) : MESH_ALIGNMENT);
+
+		if(fwrite(padding, 1, gap, file) != gap) {
+			return 0;
+		}
+
+		*position += gap;
+	}
+
+	if(bytes > 0 && fwrite(data, 1, bytes, file) != bytes) {
+		return 0;
+	}
+
+	*position += bytes;
+
+	return 1;
+}
+
+static void positionBounds(mesh const *m, float *bounds_min, float *bounds_max) {
+	size_t axis;
+	for(axis = 0; axis < 3; ++axis) {
+		bounds_min[axis] = FLT_MAX;
+		bounds_max[axis] = -FLT_MAX;
+	}
+
+	size_t s, v;
+	for(s = 0; s < m->stream_count; ++s) {
+		mesh_stream const *stream = m->streams + s;
+
+		if(stream->attribute != MESH_POSITION) {
+			continue;
+		}
+
+		for(v = 0; v < m->vertex_count; ++v) {
+			for(axis = 0; axis < 3 && axis < stream->components; ++axis) {
+				float value = stream->data[v*stream->components + axis];
+
+				bounds_min[axis] = (value < bounds_min[axis] ? value : bounds_min[axis]);
+				bounds_max[axis] = (value > bounds_max[axis] ? value : bounds_max[axis]);
+			}
+		}
+
+		break;
+	}
+
+	//No positions (or no vertices) - an empty box at the origin
+	for(axis = 0; axis < 3; ++axis) {
+		if(bounds_min[axis] > bounds_max[axis]) {
+			bounds_min[axis] = bounds_max[axis] = 0.0f;
+		}
+	}
+}
+
+int writeMesh(char const *path, mesh const *m) {
+	if(m->vertex_count > UINT32_MAX || m->index_count > UINT32_MAX || m->part_count > UINT32_MAX || m->stream_count > MESH_MAX_STREAMS) {
+		return 0;
+	}
+
+	mesh_file_header header;
+	memset(&header, 0, sizeof(header));
+
+	memcpy(header.magic, MESH_MAGIC, 4);
+	header.version = MESH_VERSION;
+	header.vertex_count = (uint32_t) m->vertex_count;
+	header.index_count = (uint32_t) m->index_count;
+	header.index_size = (uint32_t) m->index_size;
+	header.stream_count = (uint32_t) m->stream_count;
+	header.part_count = (uint32_t) m->part_count;
+	positionBounds(m, header.bounds_min, header.bounds_max);
+
+	//Data goes after the tables, every block aligned
+	mesh_file_stream streams[MESH_MAX_STREAMS];
+	uint64_t offset = sizeof(header) + m->stream_count * sizeof(mesh_file_stream) + m->part_count * sizeof(mesh_part);
+
+	size_t i;
+	for(i = 0; i < m->stream_count; ++i) {
+		offset = roundUp64(offset, MESH_ALIGNMENT);
+
+		streams[i].attribute = m->streams[i].attribute;
+		streams[i].components = m->streams[i].components;
+		streams[i].offset = offset;
+
+		offset += (uint64_t) m->vertex_count * m->streams[i].components * sizeof(float);
+	}
+
+	header.index_offset = roundUp64(offset, MESH_ALIGNMENT);
+
+	FILE *file = fopen(path, "wb");
+	if(file == NULL) {
+		return 0;
+	}
+
+	uint64_t position = 0;
+	int ok = writeAt(file, &position, 0, &header, sizeof(header))
+		  && writeAt(file, &position, position, streams, m->stream_count * sizeof(mesh_file_stream))
+		  && writeAt(file, &position, position, m->parts, m->part_count * sizeof(mesh_part));
+
+	for(i = 0; i < m->stream_count && ok; ++i) {
+		ok = writeAt(file, &position, streams[i].offset, m->streams[i].data, m->vertex_count * m->streams[i].components * sizeof(float));
+	}
+
+	ok = ok && writeAt(file, &position, header.index_offset, m->indices, m->index_count * m->index_size);
+
+	if(fclose(file) != 0) {
+		ok = 0;
+	}
+
+	return ok;
+}
+
+/*OBJ reading*/
+//Returns array, or what it was moved to if it had to grow to hold needed elements - NULL if it couldn't, in which case array is left as it was
+static void *growArray(void *array, size_t *capacity, size_t needed, size_t element_size) {
+	if(needed <= *capacity && array != NULL) {
+		return array;
+	}
+
+	size_t capacity_wanted = (*capacity > 0 ? *capacity * 2 : 64);
+	if(capacity_wanted < needed) {
+		capacity_wanted = needed;
+	}
+
+	void *grown = realloc(array, capacity_wanted * element_size);
+	if(grown != NULL) {
+		*capacity = capacity_wanted;
+	}
+
+	return grown;
+}
+
+//A float list that grows as the file is read
+typedef struct {
+	float *data;
+	size_t count;		//floats
+	size_t capacity;
+} float_list;
+
+static int pushFloats(float_list *list, float const *values, size_t count) {
+	float *grown = growArray(list->data, &list->capacity, list->count + count, sizeof(float));
+	if(grown == NULL) {
+		return 0;
+	}
+
+	list->data = grown;
+
+	memcpy(list->data + list->count, values, count * sizeof(float));
+	list->count += count;
+
+	return 1;
+}
+
+typedef struct {
+	uint32_t *data;
+	size_t count;
+	size_t capacity;
+} index_list;
+
+static int pushIndex(index_list *list, uint32_t index) {
+	uint32_t *grown = growArray(list->data, &list->capacity, list->count + 1, sizeof(uint32_t));
+	if(grown == NULL) {
+		return 0;
+	}
+
+	list->data = grown;
+
+	list->data[list->count++] = index;
+
+	return 1;
+}
+
+/*Each distinct position/texcoord/normal triple is one output vertex, found again through an open-addressing hash table
+ *Missing texture coordinates and normals are stored as -1*/
+typedef struct {
+	long position, texcoord, normal;
+	uint32_t vertex;
+} vertex_key;
+
+typedef struct {
+	float_list positions, texcoords, normals;	//as read from the file
+	float_list out_positions, out_texcoords, out_normals;
+	index_list triangles, lines;
+
+	vertex_key *table;
+	size_t table_capacity;		//a power of two, or 0
+	size_t vertex_count;
+
+	int has_texcoords, has_normals;
+} obj_reader;
+
+static size_t hashVertexKey(long position, long texcoord, long normal) {
+	size_t h = (size_t) position * 0x9E3779B1u;
+	h ^= (size_t) texcoord * 0x85EBCA77u + (h << 6) + (h >> 2);
+	h ^= (size_t) normal * 0xC2B2AE3Du + (h << 6) + (h >> 2);
+
+	return h;
+}
+
+static int growVertexTable(obj_reader *reader) {
+	size_t capacity = (reader->table_capacity > 0 ? reader->table_capacity * 2 : 1024);
+	vertex_key *table = malloc(capacity * sizeof(vertex_key));
+	if(table == NULL) {
+		return 0;
+	}
+
+	size_t i;
+	for(i = 0; i < capacity; ++i) {
+		table[i].position = -1;
+	}
+
+	for(i = 0; i < reader->table_capacity; ++i) {
+		vertex_key *key = reader->table + i;
+		if(key->position < 0) {
+			continue;
+		}
+
+		size_t slot = hashVertexKey(key->position, key->texcoord, key->normal) & (capacity - 1);
+		while(table[slot].position >= 0) {
+			slot = (slot + 1) & (capacity - 1);
+		}
+
+		table[slot] = *key;
+	}
+
+	free(reader->table);
+	reader->table = table;
+	reader->table_capacity = capacity;
+
+	return 1;
+}
+
+//Output vertex for the given (already resolved, 0-based) indices, added if it's new; returns 0 on allocation failure
+static int findVertex(obj_reader *reader, long position, long texcoord, long normal, uint32_t *vertex) {
+	//Kept at most half full
+	if((reader->vertex_count + 1) * 2 > reader->table_capacity && !growVertexTable(reader)) {
+		return 0;
+	}
+
+	size_t slot = hashVertexKey(position, texcoord, normal) & (reader->table_capacity - 1);
+	while(reader->table[slot].position >= 0) {
+		vertex_key *key = reader->table + slot;
+
+		if(key->position == position && key->texcoord == texcoord && key->normal == normal) {
+			*vertex = key->vertex;
+
+			return 1;
+		}
+
+		slot = (slot + 1) & (reader->table_capacity - 1);
+	}
+
+	static float const zeroes[3] = {0.0f, 0.0f, 0.0f};
+
+	if(!pushFloats(&reader->out_positions, reader->positions.data + position*3, 3)
+	   || !pushFloats(&reader->out_texcoords, texcoord >= 0 ? reader->texcoords.data + texcoord*2 : zeroes, 2)
+	   || !pushFloats(&reader->out_normals, normal >= 0 ? reader->normals.data + normal*3 : zeroes, 3)) {
+		return 0;
+	}
+
+	vertex_key *key = reader->table + slot;
+	key->position = position;
+	key->texcoord = texcoord;
+	key->normal = normal;
+	key->vertex = (uint32_t) reader->vertex_count++;
+
+	reader->has_texcoords |= (texcoord >= 0);
+	reader->has_normals |= (normal >= 0);
+
+	*vertex = key->vertex;
+
+	return 1;
+}
+
+//1-based, or negative to count back from the latest element; returns -1 if it's out of range
+static long resolveObjIndex(long index, size_t count) {
+	if(index > 0 && (size_t) index <= count) {
+		return index - 1;
+	}
+
+	if(index < 0 && (size_t) -index <= count) {
+		return (long) count + index;
+	}
+
+	return -1;
+}
+
+static char const *skipSpaces(char const *c) {
+	while(*c == ' ' || *c == '\t') {
+		++c;
+	}
+
+	return c;
+}
+
+//Reads one "p", "p/t", "p//n" or "p/t/n" vertex reference, advancing *c past it
+//Returns 1 on success, 0 at the end of the line and -1 for a malformed or out of range reference (with *error set)
+static int readVertexReference(obj_reader *reader, char const **c, uint32_t *vertex, char const **error) {
+	char const *cursor = skipSpaces(*c);
+	if(*cursor == '\0' || *cursor == '\n' || *cursor == '\r' || *cursor == '#') {
+		return 0;
+	}
+
+	char *end;
+	long position = resolveObjIndex(strtol(cursor, &end, 10), reader->positions.count / 3);
+	long texcoord = -1, normal = -1;
+
+	if(end == cursor || position < 0) {
+		setError(error, "face or line refers to a position that doesn't exist");
+
+		return -1;
+	}
+	cursor = end;
+
+	if(*cursor == '/') {
+		++cursor;
+
+		if(*cursor != '/') {
+			texcoord = resolveObjIndex(strtol(cursor, &end, 10), reader->texcoords.count / 2);
+			if(end == cursor || texcoord < 0) {
+				setError(error, "face or line refers to a texture coordinate that doesn't exist");
+
+				return -1;
+			}
+			cursor = end;
+		}
+
+		if(*cursor == '/') {
+			++cursor;
+
+			normal = resolveObjIndex(strtol(cursor, &end, 10), reader->normals.count / 3);
+			if(end == cursor || normal < 0) {
+				setError(error, "face or line refers to a normal that doesn't exist");
+
+				return -1;
+			}
+			cursor = end;
+		}
+	}
+
+	*c = cursor;
+
+	if(!findVertex(reader, position, texcoord, normal, vertex)) {
+		setError(error, "out of memory");
+
+		return -1;
+	}
+
+	return 1;
+}
+
+//Reads up to count floats, missing ones being 0
+static int readObjFloats(char const *c, float_list *list, size_t count) {
+	float values[3] = {0.0f, 0.0f, 0.0f};
+
+	size_t i;
+	for(i = 0; i < count; ++i) {
+		char *end;
+		float value = strtof(c, &end);
+
+		if(end == c) {
+			break;
+		}
+
+		values[i] = value;
+		c = end;
+	}
+
+	return pushFloats(list, values, count);
+}
+
+//One line, without its terminator; returns 0 with *error set on failure
+static int readObjLine(obj_reader *reader, char const *line, char const **error) {
+	line = skipSpaces(line);
+
+	int ok = 1;
+
+	if(line[0] == 'v' && (line[1] == ' ' || line[1] == '\t')) {
+		ok = readObjFloats(line + 2, &reader->positions, 3);
+	} else if(line[0] == 'v' && line[1] == 't' && (line[2] == ' ' || line[2] == '\t')) {
+		ok = readObjFloats(line + 3, &reader->texcoords, 2);
+	} else if(line[0] == 'v' && line[1] == 'n' && (line[2] == ' ' || line[2] == '\t')) {
+		ok = readObjFloats(line + 3, &reader->normals, 3);
+	} else if((line[0] == 'f' || line[0] == 'l') && (line[1] == ' ' || line[1] == '\t')) {
+		char const *c = line + 2;
+		uint32_t first = 0, previous = 0, current;
+		size_t count = 0;
+		int read;
+
+		while((read = readVertexReference(reader, &c, &current, error)) == 1) {
+			if(line[0] == 'f' && count >= 2) {
+				//A fan around the first vertex
+				ok = pushIndex(&reader->triangles, first) && pushIndex(&reader->triangles, previous) && pushIndex(&reader->triangles, current);
+			} else if(line[0] == 'l' && count >= 1) {
+				ok = pushIndex(&reader->lines, previous) && pushIndex(&reader->lines, current);
+			}
+
+			if(!ok) {
+				break;
+			}
+
+			if(count == 0) {
+				first = current;
+			}
+
+			previous = current;
+			++count;
+		}
+
+		if(read < 0) {
+			return 0;
+		}
+	}
+
+	if(!ok) {
+		setError(error, "out of memory");
+	}
+
+	return ok;
+}
+
+static char *readWholeFile(char const *path, size_t *size) {
+	FILE *file = fopen(path, "rb");
+	if(file == NULL) {
+		return NULL;
+	}
+
+	char *contents = NULL;
+	size_t capacity = 0;
+	size_t length = 0;
+
+	for(;;) {
+		char *grown = growArray(contents, &capacity, length + 65536 + 1, 1);
+		if(grown == NULL) {
+			free(contents);
+			fclose(file);
+
+			return NULL;
+		}
+
+		contents = grown;
+
+		size_t read = fread(contents + length, 1, capacity - length - 1, file);
+		length += read;
+
+		if(read == 0) {
+			break;
+		}
+	}
+
+	int failed = ferror(file);
+	fclose(file);
+
+	if(failed) {
+		free(contents);
+
+		return NULL;
+	}
+
+	contents[length] = '\0';
+	*size = length;
+
+	return contents;
+}
+
+static void freeObjReader(obj_reader *reader) {
+	free(reader->positions.data);
+	free(reader->texcoords.data);
+	free(reader->normals.data);
+	free(reader->out_positions.data);
+	free(reader->out_texcoords.data);
+	free(reader->out_normals.data);
+	free(reader->triangles.data);
+	free(reader->lines.data);
+	free(reader->table);
+}
+
+static void storeIndices(void *out, uint32_t const *indices, size_t count, size_t index_size) {
+	size_t i;
+	switch(index_size) {
+		case 1:
+			for(i = 0; i < count; ++i) {
+				((uint8_t *) out)[i] = (uint8_t) indices[i];
+			}
+
+			break;
+		case 2:
+			for(i = 0; i < count; ++i) {
+				((uint16_t *) out)[i] = (uint16_t) indices[i];
+			}
+
+			break;
+		default:
+			if(count > 0) {
+				memcpy(out, indices, count * sizeof(uint32_t));
+			}
+	}
+}
+
+/*A mesh with one heap block, which closeMesh frees, carved up for the given parts, streams and indices - the caller fills them
+ *in through the (otherwise const) pointers. Parts come first, then the streams, then the indices, so every block stays aligned for its type*/
+static mesh *allocateMesh(size_t part_count, size_t stream_count, MESH_ATTRIBUTE const *attributes, unsigned int const *components,
+						  size_t vertex_count, size_t index_count) {
+	mesh *m = calloc(1, sizeof(mesh));
+	if(m == NULL) {
+		return NULL;
+	}
+
+	m->vertex_count = vertex_count;
+	m->stream_count = stream_count;
+	m->index_count = index_count;
+	m->index_size = meshIndexSize(vertex_count);
+	m->part_count = part_count;
+
+	size_t size = part_count * sizeof(mesh_part) + roundUp64(index_count * m->index_size, sizeof(float));
+	size_t s;
+	for(s = 0; s < stream_count; ++s) {
+		size += vertex_count * components[s] * sizeof(float);
+	}
+
+	unsigned char *storage = malloc(size > 0 ? size : 1);
+	if(storage == NULL) {
+		free(m);
+
+		return NULL;
+	}
+
+	m->storage = storage;
+	m->storage_size = size;
+
+	m->parts = (mesh_part const *) storage;
+	storage += part_count * sizeof(mesh_part);
+
+	for(s = 0; s < stream_count; ++s) {
+		m->streams[s].attribute = attributes[s];
+		m->streams[s].components = components[s];
+		m->streams[s].data = (float const *) storage;
+
+		storage += vertex_count * components[s] * sizeof(float);
+	}
+
+	m->indices = storage;
+
+	return m;
+}
+
+static mesh *finishObjMesh(obj_reader *reader) {
+	float_list *streams[3] = {&reader->out_positions, &reader->out_texcoords, &reader->out_normals};
+	MESH_ATTRIBUTE const all_attributes[3] = {MESH_POSITION, MESH_TEXCOORD, MESH_NORMAL};
+	unsigned int const all_components[3] = {3, 2, 3};
+	int const used[3] = {1, reader->has_texcoords, reader->has_normals};
+
+	MESH_ATTRIBUTE attributes[3];
+	unsigned int components[3];
+	float_list *used_streams[3];
+	size_t stream_count = 0;
+
+	size_t s;
+	for(s = 0; s < 3; ++s) {
+		if(used[s]) {
+			attributes[stream_count] = all_attributes[s];
+			components[stream_count] = all_components[s];
+			used_streams[stream_count++] = streams[s];
+		}
+	}
+
+	size_t part_count = (reader->triangles.count > 0) + (reader->lines.count > 0);
+	mesh *m = allocateMesh(part_count, stream_count, attributes, components, reader->vertex_count, reader->triangles.count + reader->lines.count);
+	if(m == NULL) {
+		return NULL;
+	}
+
+	mesh_part *parts = (mesh_part *) m->parts;
+	size_t part = 0;
+
+	if(reader->triangles.count > 0) {
+		mesh_part triangles = {MESH_TRIANGLES, 0, (uint32_t) reader->triangles.count, 0};
+		parts[part++] = triangles;
+	}
+	if(reader->lines.count > 0) {
+		mesh_part lines = {MESH_LINES, (uint32_t) reader->triangles.count, (uint32_t) reader->lines.count, 0};
+		parts[part++] = lines;
+	}
+
+	for(s = 0; s < stream_count; ++s) {
+		memcpy((float *) m->streams[s].data, used_streams[s]->data, used_streams[s]->count * sizeof(float));
+	}
+
+	unsigned char *indices = (unsigned char *) m->indices;
+	storeIndices(indices, reader->triangles.data, reader->triangles.count, m->index_size);
+	storeIndices(indices + reader->triangles.count * m->index_size, reader->lines.data, reader->lines.count, m->index_size);
+
+	positionBounds(m, m->bounds_min, m->bounds_max);
+
+	return m;
+}
+
+mesh *loadObjMesh(char const *path, char const **error) {
+	size_t size;
+	char *contents = readWholeFile(path, &size);
+	if(contents == NULL) {
+		setError(error, "couldn't read the file");
+
+		return NULL;
+	}
+
+	obj_reader reader;
+	memset(&reader, 0, sizeof(reader));
+
+	int ok = 1;
+	char *line = contents;
+
+	while(ok && line < contents + size) {
+		char *end = strchr(line, '\n');
+		if(end != NULL) {
+			*end = '\0';
+		}
+
+		ok = readObjLine(&reader, line, error);
+
+		line = (end != NULL ? end + 1 : contents + size);
+	}
+
+	free(contents);
+
+	mesh *m = NULL;
+
+	if(ok && reader.vertex_count == 0) {
+		setError(error, "no faces or lines");
+	} else if(ok && reader.vertex_count > UINT32_MAX) {
+		setError(error, "too many vertices");
+	} else if(ok) {
+		m = finishObjMesh(&reader);
+
+		if(m == NULL) {
+			setError(error, "out of memory");
+		}
+	}
+
+	freeObjReader(&reader);
+
+	return m;
+}
+
+/*Index and vertex order*/
+int meshCacheStatistics(uint32_t const *indices, size_t index_count, size_t vertex_count, mesh_cache_statistics *statistics) {
+	//A vertex is cached while fewer than MESH_CACHE_SIZE others have been loaded since it was - 0 being never
+	size_t *loaded_at = calloc(vertex_count > 0 ? vertex_count : 1, sizeof(size_t));
+	if(loaded_at == NULL) {
+		return 0;
+	}
+
+	size_t time = MESH_CACHE_SIZE + 1;
+	size_t misses = 0, used = 0;
+
+	size_t i;
+	for(i = 0; i < index_count; ++i) {
+		uint32_t vertex = indices[i];
+
+		if(time - loaded_at[vertex] > MESH_CACHE_SIZE) {
+			used += (loaded_at[vertex] == 0);
+			loaded_at[vertex] = time++;
+			++misses;
+		}
+	}
+
+	free(loaded_at);
+
+	statistics->acmr = (index_count >= 3 ? (float) misses / (float) (index_count / 3) : 0.0f);
+	statistics->atvr = (used > 0 ? (float) misses / (float) used : 0.0f);
+
+	return 1;
+}
+
+size_t triangulatePart(uint32_t *out, mesh const *m, mesh_part const *part) {
+	if(part->mode != MESH_TRIANGLES && part->mode != MESH_TRIANGLE_STRIP && part->mode != MESH_TRIANGLE_FAN) {
+		return 0;
+	}
+
+	size_t written = 0;
+
+	size_t i;
+	for(i = 0; i + 2 < part->count; i += (part->mode == MESH_TRIANGLES ? 3 : 1)) {
+		uint32_t a, b, c;
+
+		switch(part->mode) {
+			case MESH_TRIANGLES:
+				a = meshIndex(m, part->first + i);
+				b = meshIndex(m, part->first + i + 1);
+				c = meshIndex(m, part->first + i + 2);
+
+				break;
+			case MESH_TRIANGLE_STRIP:
+				//Every other triangle is wound the other way round, which has to be undone
+				a = meshIndex(m, part->first + i + (i & 1));
+				b = meshIndex(m, part->first + i + 1 - (i & 1));
+				c = meshIndex(m, part->first + i + 2);
+
+				break;
+			default:
+				a = meshIndex(m, part->first);
+				b = meshIndex(m, part->first + i + 1);
+				c = meshIndex(m, part->first + i + 2);
+		}
+
+		//Strips are often stitched together with these
+		if(a == b || b == c || c == a) {
+			continue;
+		}
+
+		out[written++] = a;
+		out[written++] = b;
+		out[written++] = c;
+	}
+
+	return written;
+}
+
+/*Forsyth's scoring: a vertex is worth more the more recently it was used (except for the last triangle's three, which are
+ *about as good as each other and slightly less than the next few, so strips don't run on forever), and the fewer triangles it
+ *has left to draw, so lone triangles aren't stranded to miss the cache later. A triangle's score is its vertices'*/
+#define FORSYTH_CACHE_SIZE 32
+#define FORSYTH_VALENCE_TABLE 32
+
+static float forsyth_cache_score[FORSYTH_CACHE_SIZE];
+static float forsyth_valence_score[FORSYTH_VALENCE_TABLE];
+static int forsyth_scores_ready = 0;
+
+static void initForsythScores(void) {
+	size_t i;
+	for(i = 0; i < FORSYTH_CACHE_SIZE; ++i) {
+		forsyth_cache_score[i] = (i < 3 ? 0.75f : powf(1.0f - (float) (i - 3) / (FORSYTH_CACHE_SIZE - 3), 1.5f));
+	}
+
+	for(i = 0; i < FORSYTH_VALENCE_TABLE; ++i) {
+		forsyth_valence_score[i] = (i > 0 ? 2.0f / sqrtf((float) i) : 0.0f);
+	}
+
+	forsyth_scores_ready = 1;
+}
+
+static float forsythScore(int cache_position, uint32_t remaining) {
+	//Nothing left to draw with it, so keeping it in the cache is worthless
+	if(remaining == 0) {
+		return -1.0f;
+	}
+
+	float score = (cache_position >= 0 ? forsyth_cache_score[cache_position] : 0.0f);
+
+	return score + (remaining < FORSYTH_VALENCE_TABLE ? forsyth_valence_score[remaining] : 2.0f / sqrtf((float) remaining));
+}
+
+int optimizeVertexCache(uint32_t *indices, size_t index_count, size_t vertex_count) {
+	size_t triangle_count = index_count / 3;
+	if(triangle_count == 0) {
+		return 1;
+	}
+
+	if(!forsyth_scores_ready) {
+		initForsythScores();
+	}
+
+	//Every vertex's triangles, as ranges of one array; each vertex's range shrinks as its triangles are drawn
+	uint32_t *first_triangle = malloc(sizeof(uint32_t) * (vertex_count + 1));
+	uint32_t *remaining = calloc(vertex_count > 0 ? vertex_count : 1, sizeof(uint32_t));
+	uint32_t *vertex_triangles = malloc(sizeof(uint32_t) * triangle_count * 3);
+	int *cache_position = malloc(sizeof(int) * (vertex_count > 0 ? vertex_count : 1));
+	float *vertex_score = malloc(sizeof(float) * (vertex_count > 0 ? vertex_count : 1));
+	float *triangle_score = malloc(sizeof(float) * triangle_count);
+	unsigned char *drawn = calloc(triangle_count, 1);
+	uint32_t *result = malloc(sizeof(uint32_t) * triangle_count * 3);
+
+	if(first_triangle == NULL || remaining == NULL || vertex_triangles == NULL || cache_position == NULL || vertex_score == NULL
+	   || triangle_score == NULL || drawn == NULL || result == NULL) {
+		free(first_triangle);
+		free(remaining);
+		free(vertex_triangles);
+		free(cache_position);
+		free(vertex_score);
+		free(triangle_score);
+		free(drawn);
+		free(result);
+
+		return 0;
+	}
+
+	size_t i;
+	for(i = 0; i < triangle_count * 3; ++i) {
+		++remaining[indices[i]];
+	}
+
+	uint32_t offset = 0;
+	size_t v;
+	for(v = 0; v < vertex_count; ++v) {
+		first_triangle[v] = offset;
+		offset += remaining[v];
+
+		//Reset to be counted up again as the ranges are filled
+		remaining[v] = 0;
+		cache_position[v] = -1;
+	}
+	first_triangle[vertex_count] = offset;
+
+	for(i = 0; i < triangle_count * 3; ++i) {
+		uint32_t vertex = indices[i];
+		vertex_triangles[first_triangle[vertex] + remaining[vertex]++] = (uint32_t) (i / 3);
+	}
+
+	for(v = 0; v < vertex_count; ++v) {
+		vertex_score[v] = forsythScore(-1, remaining[v]);
+	}
+
+	size_t t;
+	for(t = 0; t < triangle_count; ++t) {
+		triangle_score[t] = vertex_score[indices[t*3]] + vertex_score[indices[t*3 + 1]] + vertex_score[indices[t*3 + 2]];
+	}
+
+	//The simulated LRU cache, with room for the three vertices pushed in before the oldest fall out
+	uint32_t cache[FORSYTH_CACHE_SIZE + 3];
+	uint32_t next_cache[FORSYTH_CACHE_SIZE + 3];
+	size_t cache_count = 0;
+
+	size_t written = 0;
+	size_t next_unvisited = 0;
+	size_t best = 0;
+	int have_best = 0;
+
+	while(written < triangle_count * 3) {
+		//Nothing in the cache has triangles left - carry on from the first undrawn one in the original order
+		if(!have_best) {
+			while(drawn[next_unvisited]) {
+				++next_unvisited;
+			}
+
+			best = next_unvisited;
+		}
+
+		drawn[best] = 1;
+
+		size_t corner;
+		for(corner = 0; corner < 3; ++corner) {
+			uint32_t vertex = indices[best*3 + corner];
+			result[written++] = vertex;
+
+			//Take best out of vertex's range
+			uint32_t *triangles = vertex_triangles + first_triangle[vertex];
+			size_t k;
+			for(k = 0; triangles[k] != best; ++k);
+			triangles[k] = triangles[--remaining[vertex]];
+		}
+
+		//best's vertices go to the front, everything else that was cached moves back behind them
+		size_t next_count = 0;
+		for(corner = 0; corner < 3; ++corner) {
+			next_cache[next_count++] = indices[best*3 + corner];
+		}
+
+		for(i = 0; i < cache_count; ++i) {
+			uint32_t vertex = cache[i];
+
+			if(vertex != next_cache[0] && vertex != next_cache[1] && vertex != next_cache[2]) {
+				next_cache[next_count++] = vertex;
+			}
+		}
+
+		//Rescore everything whose position changed, passing the difference on to its triangles, and find the best of them
+		float best_score = -1.0f;
+		have_best = 0;
+
+		for(i = 0; i < next_count; ++i) {
+			uint32_t vertex = next_cache[i];
+			cache_position[vertex] = (i < FORSYTH_CACHE_SIZE ? (int) i : -1);
+
+			float score = forsythScore(cache_position[vertex], remaining[vertex]);
+			float change = score - vertex_score[vertex];
+			vertex_score[vertex] = score;
+
+			uint32_t const *triangles = vertex_triangles + first_triangle[vertex];
+			size_t k;
+			for(k = 0; k < remaining[vertex]; ++k) {
+				triangle_score[triangles[k]] += change;
+
+				if(i < FORSYTH_CACHE_SIZE && triangle_score[triangles[k]] > best_score) {
+					best_score = triangle_score[triangles[k]];
+					best = triangles[k];
+					have_best = 1;
+				}
+			}
+		}
+
+		cache_count = (next_count < FORSYTH_CACHE_SIZE ? next_count : FORSYTH_CACHE_SIZE);
+		memcpy(cache, next_cache, sizeof(uint32_t) * cache_count);
+	}
+
+	memcpy(indices, result, sizeof(uint32_t) * triangle_count * 3);
+
+	free(first_triangle);
+	free(remaining);
+	free(vertex_triangles);
+	free(cache_position);
+	free(vertex_score);
+	free(triangle_score);
+	free(drawn);
+	free(result);
+
+	return 1;
+}
+
+typedef struct {
+	float key;			//how much the cluster faces away from the middle of the mesh
+	size_t first;		//in triangles
+	size_t count;
+} triangle_cluster;
+
+static int compareClusters(void const *a, void const *b) {
+	triangle_cluster const *x = a;
+	triangle_cluster const *y = b;
+
+	//Most outward first, ties left in their original order so the result doesn't depend on qsort
+	if(x->key != y->key) {
+		return (x->key > y->key ? -1 : 1);
+	}
+
+	return (x->first > y->first) - (x->first < y->first);
+}
+
+int optimizeOverdraw(uint32_t *indices, size_t index_count, float const *positions, unsigned int components, size_t vertex_count) {
+	size_t triangle_count = index_count / 3;
+	if(triangle_count < 2) {
+		return 1;
+	}
+
+	size_t *loaded_at = calloc(vertex_count > 0 ? vertex_count : 1, sizeof(size_t));
+	triangle_cluster *clusters = malloc(sizeof(triangle_cluster) * triangle_count);
+	float *cluster_sums = malloc(sizeof(float) * 6 * triangle_count);
+	uint32_t *result = malloc(sizeof(uint32_t) * triangle_count * 3);
+
+	if(loaded_at == NULL || clusters == NULL || cluster_sums == NULL || result == NULL) {
+		free(loaded_at);
+		free(clusters);
+		free(cluster_sums);
+		free(result);
+
+		return 0;
+	}
+
+	//Splitting wherever a triangle misses on all three vertices, as nothing before it in the cache was any use to it anyway
+	size_t time = MESH_CACHE_SIZE + 1;
+	size_t cluster_count = 0;
+
+	size_t t;
+	for(t = 0; t < triangle_count; ++t) {
+		size_t misses = 0;
+
+		size_t corner;
+		for(corner = 0; corner < 3; ++corner) {
+			uint32_t vertex = indices[t*3 + corner];
+
+			if(time - loaded_at[vertex] > MESH_CACHE_SIZE) {
+				loaded_at[vertex] = time++;
+				++misses;
+			}
+		}
+
+		if(t == 0 || misses == 3) {
+			clusters[cluster_count].first = t;
+			clusters[cluster_count].count = 0;
+			++cluster_count;
+		}
+
+		++clusters[cluster_count - 1].count;
+	}
+
+	//Each cluster's area-weighted centroid and normal (both scaled by twice its area), and the whole mesh's centroid
+	float mesh_centroid[3] = {0.0f, 0.0f, 0.0f};
+	float mesh_area = 0.0f;
+
+	size_t c;
+	for(c = 0; c < cluster_count; ++c) {
+		float *sums = cluster_sums + c*6;
+		memset(sums, 0, sizeof(float) * 6);
+
+		float area = 0.0f;
+
+		for(t = clusters[c].first; t < clusters[c].first + clusters[c].count; ++t) {
+			float const *p0 = positions + (size_t) indices[t*3] * components;
+			float const *p1 = positions + (size_t) indices[t*3 + 1] * components;
+			float const *p2 = positions + (size_t) indices[t*3 + 2] * components;
+
+			float e1[3] = {p1[0] - p0[0], p1[1] - p0[1], p1[2] - p0[2]};
+			float e2[3] = {p2[0] - p0[0], p2[1] - p0[1], p2[2] - p0[2]};
+			float normal[3] = {e1[1]*e2[2] - e1[2]*e2[1], e1[2]*e2[0] - e1[0]*e2[2], e1[0]*e2[1] - e1[1]*e2[0]};
+			float twice_area = sqrtf(normal[0]*normal[0] + normal[1]*normal[1] + normal[2]*normal[2]);
+
+			size_t axis;
+			for(axis = 0; axis < 3; ++axis) {
+				sums[axis] += (p0[axis] + p1[axis] + p2[axis]) * (1.0f/3.0f) * twice_area;
+				sums[3 + axis] += normal[axis];
+			}
+
+			area += twice_area;
+		}
+
+		size_t axis;
+		for(axis = 0; axis < 3; ++axis) {
+			mesh_centroid[axis] += sums[axis];
+		}
+
+		mesh_area += area;
+
+		for(axis = 0; axis < 3; ++axis) {
+			sums[axis] = (area > 0.0f ? sums[axis] / area : 0.0f);
+		}
+	}
+
+	size_t axis;
+	for(axis = 0; axis < 3; ++axis) {
+		mesh_centroid[axis] = (mesh_area > 0.0f ? mesh_centroid[axis] / mesh_area : 0.0f);
+	}
+
+	for(c = 0; c < cluster_count; ++c) {
+		float const *sums = cluster_sums + c*6;
+		float length = sqrtf(sums[3]*sums[3] + sums[4]*sums[4] + sums[5]*sums[5]);
+
+		float key = 0.0f;
+		for(axis = 0; axis < 3; ++axis) {
+			key += (sums[axis] - mesh_centroid[axis]) * sums[3 + axis];
+		}
+
+		clusters[c].key = (length > 0.0f ? key / length : 0.0f);
+	}
+
+	qsort(clusters, cluster_count, sizeof(triangle_cluster), compareClusters);
+
+	size_t written = 0;
+	for(c = 0; c < cluster_count; ++c) {
+		memcpy(result + written, indices + clusters[c].first*3, sizeof(uint32_t) * clusters[c].count * 3);
+		written += clusters[c].count * 3;
+	}
+
+	memcpy(indices, result, sizeof(uint32_t) * written);
+
+	free(loaded_at);
+	free(clusters);
+	free(cluster_sums);
+	free(result);
+
+	return 1;
+}
+
+static mesh_stream const *positionStream(mesh const *m) {
+	size_t s;
+	for(s = 0; s < m->stream_count; ++s) {
+		if(m->streams[s].attribute == MESH_POSITION && m->streams[s].components >= 3) {
+			return m->streams + s;
+		}
+	}
+
+	return NULL;
+}
+
+//optimizeMesh, given room for every index as a triangle list or not (indices), for its parts and for every vertex's new number
+static mesh *optimizeMeshWith(mesh const *m, uint32_t *indices, mesh_part *parts, uint32_t *renumbered,
+							  mesh_cache_statistics *before, mesh_cache_statistics *after) {
+	//Triangle parts first, as one list, then the others
+	size_t triangle_indices = 0;
+
+	size_t p;
+	for(p = 0; p < m->part_count; ++p) {
+		triangle_indices += triangulatePart(indices + triangle_indices, m, m->parts + p);
+	}
+
+	size_t part_count = 0;
+	if(triangle_indices > 0) {
+		mesh_part triangles = {MESH_TRIANGLES, 0, (uint32_t) triangle_indices, 0};
+		parts[part_count++] = triangles;
+	}
+
+	size_t index_count = triangle_indices;
+	for(p = 0; p < m->part_count; ++p) {
+		mesh_part const *part = m->parts + p;
+
+		if(part->mode >= MESH_TRIANGLES) {
+			continue;
+		}
+
+		mesh_part other = {part->mode, (uint32_t) index_count, part->count, 0};
+		parts[part_count++] = other;
+
+		size_t i;
+		for(i = 0; i < part->count; ++i) {
+			indices[index_count++] = meshIndex(m, part->first + i);
+		}
+	}
+
+	if(before != NULL && !meshCacheStatistics(indices, triangle_indices, m->vertex_count, before)) {
+		return NULL;
+	}
+
+	if(!optimizeVertexCache(indices, triangle_indices, m->vertex_count)) {
+		return NULL;
+	}
+
+	mesh_stream const *positions = positionStream(m);
+	if(positions != NULL && !optimizeOverdraw(indices, triangle_indices, positions->data, positions->components, m->vertex_count)) {
+		return NULL;
+	}
+
+	//Vertices numbered in the order they're first used
+	size_t vertex_count = 0;
+
+	size_t v;
+	for(v = 0; v < m->vertex_count; ++v) {
+		renumbered[v] = UINT32_MAX;
+	}
+
+	size_t i;
+	for(i = 0; i < index_count; ++i) {
+		if(renumbered[indices[i]] == UINT32_MAX) {
+			renumbered[indices[i]] = (uint32_t) vertex_count++;
+		}
+
+		indices[i] = renumbered[indices[i]];
+	}
+
+	if(after != NULL && !meshCacheStatistics(indices, triangle_indices, vertex_count, after)) {
+		return NULL;
+	}
+
+	MESH_ATTRIBUTE attributes[MESH_MAX_STREAMS];
+	unsigned int components[MESH_MAX_STREAMS];
+
+	size_t s;
+	for(s = 0; s < m->stream_count; ++s) {
+		attributes[s] = m->streams[s].attribute;
+		components[s] = m->streams[s].components;
+	}
+
+	mesh *result = allocateMesh(part_count, m->stream_count, attributes, components, vertex_count, index_count);
+	if(result == NULL) {
+		return NULL;
+	}
+
+	memcpy((mesh_part *) result->parts, parts, sizeof(mesh_part) * part_count);
+
+	for(s = 0; s < m->stream_count; ++s) {
+		float *data = (float *) result->streams[s].data;
+
+		for(v = 0; v < m->vertex_count; ++v) {
+			if(renumbered[v] != UINT32_MAX) {
+				memcpy(data + (size_t) renumbered[v] * components[s], m->streams[s].data + v * components[s], sizeof(float) * components[s]);
+			}
+		}
+	}
+
+	storeIndices((void *) result->indices, indices, index_count, result->index_size);
+
+	positionBounds(result, result->bounds_min, result->bounds_max);
+
+	return result;
+}
+
+mesh *optimizeMesh(mesh const *m, mesh_cache_statistics *before, mesh_cache_statistics *after) {
+	size_t room = 0;
+
+	size_t p;
+	for(p = 0; p < m->part_count; ++p) {
+		room += (m->parts[p].mode >= MESH_TRIANGLES ? (size_t) m->parts[p].count * 3 : m->parts[p].count);
+	}
+
+	uint32_t *indices = malloc(sizeof(uint32_t) * (room > 0 ? room : 1));
+	mesh_part *parts = malloc(sizeof(mesh_part) * (m->part_count + 1));
+	uint32_t *renumbered = malloc(sizeof(uint32_t) * (m->vertex_count > 0 ? m->vertex_count : 1));
+
+	mesh *result = NULL;
+
+	if(indices != NULL && parts != NULL && renumbered != NULL) {
+		result = optimizeMeshWith(m, indices, parts, renumbered, before, after);
+	}
+
+	free(indices);
+	free(parts);
+	free(renumbered);
+
+	return result;
+}
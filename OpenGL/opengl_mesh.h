@@ -0,0 +1,160 @@
+#ifndef OPENGL_MESH_H
+#define OPENGL_MESH_H
+
+#include <stdlib.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*Binary meshes
+ *A mesh file is laid out so it can be used exactly as it sits on disk: openMesh maps it into memory, checks it, and points straight
+ *into the mapping, so the vertex streams and indices can go to glBufferData without being parsed or copied first
+ *
+ *Layout (little-endian, every offset counted from the start of the file):
+ *	mesh_file_header
+ *	mesh_file_stream[stream_count]
+ *	mesh_part[part_count]
+ *	each stream's data, vertex_count * components floats, starting on a MESH_ALIGNMENT boundary
+ *	the indices, index_count * index_size bytes, starting on a MESH_ALIGNMENT boundary*/
+#define MESH_MAGIC "MESH"
+#define MESH_VERSION 1
+#define MESH_ALIGNMENT 16
+#define MESH_MAX_STREAMS 8
+
+//What a vertex stream holds
+typedef enum {MESH_POSITION, MESH_NORMAL, MESH_TEXCOORD, MESH_COLOR} MESH_ATTRIBUTE;
+
+//Primitive types, with the same values as OpenGL's, so they can be passed to glDrawElements as they are
+#define MESH_POINTS 0x0000
+#define MESH_LINES 0x0001
+#define MESH_LINE_LOOP 0x0002
+#define MESH_LINE_STRIP 0x0003
+#define MESH_TRIANGLES 0x0004
+#define MESH_TRIANGLE_STRIP 0x0005
+#define MESH_TRIANGLE_FAN 0x0006
+
+typedef struct {
+	char magic[4];			//MESH_MAGIC, without its terminator
+	uint32_t version;		//MESH_VERSION
+	uint32_t vertex_count;
+	uint32_t index_count;
+	uint32_t index_size;	//bytes per index: 1, 2 or 4
+	uint32_t stream_count;
+	uint32_t part_count;
+	uint32_t reserved;		//0
+	uint64_t index_offset;
+	float bounds_min[3];	//of the positions
+	float bounds_max[3];
+} mesh_file_header;
+
+typedef struct {
+	uint32_t attribute;		//MESH_ATTRIBUTE
+	uint32_t components;	//floats per vertex, 1 to 4
+	uint64_t offset;
+} mesh_file_stream;
+
+//A range of the indices, drawn as one primitive type
+typedef struct {
+	uint32_t mode;			//MESH_POINTS to MESH_TRIANGLE_FAN
+	uint32_t first;			//in indices, not bytes
+	uint32_t count;
+	uint32_t reserved;		//0
+} mesh_part;
+
+typedef struct {
+	MESH_ATTRIBUTE attribute;
+	unsigned int components;
+	float const *data;		//vertex_count * components floats
+} mesh_stream;
+
+/*A mesh, either mapped from a file by openMesh or read by loadObjMesh - or put together by hand, pointing at any arrays, to be written
+ *with writeMesh. Whatever openMesh and loadObjMesh return is read-only and stays valid until closeMesh*/
+typedef struct {
+	size_t vertex_count;
+	size_t stream_count;
+	mesh_stream streams[MESH_MAX_STREAMS];
+
+	size_t index_count;
+	size_t index_size;
+	void const *indices;
+
+	size_t part_count;
+	mesh_part const *parts;
+
+	float bounds_min[3];
+	float bounds_max[3];
+
+	void *storage;			//the mapping, or the heap block for loadObjMesh (NULL for meshes put together by hand)
+	size_t storage_size;
+	int mapped;				//whether storage is a mapping
+	void *mapping_handle;	//Windows' file mapping object
+} mesh;
+
+//Maps the file at path and checks that every range it describes lies inside it, and that every index is below vertex_count
+//Returns NULL on failure, setting *error (when error isn't NULL) to a static description of what went wrong
+mesh *openMesh(char const *path, char const **error);
+
+//Unmaps or frees m
+void closeMesh(mesh *m);
+
+//The bounds are computed from m's MESH_POSITION stream rather than taken from m
+//Returns 0 on failure (or if m has more than 2^32 - 1 vertices or indices) - the file may be left half written
+int writeMesh(char const *path, mesh const *m);
+
+//Smallest index size (1, 2 or 4 bytes) that can address vertex_count vertices
+size_t meshIndexSize(size_t vertex_count);
+
+//Index i of m, whatever its index size
+uint32_t meshIndex(mesh const *m, size_t i);
+
+/*Wavefront OBJ
+ *Reads positions, texture coordinates and normals (v, vt, vn), faces (f, triangulated as fans) and polylines (l), ignoring everything else
+ *Every distinct position/texcoord/normal combination becomes one vertex. Faces end up in a single MESH_TRIANGLES part and polylines
+ *in a MESH_LINES part after it. Returns NULL on failure, with *error set as for openMesh*/
+mesh *loadObjMesh(char const *path, char const **error);
+
+/*Index and vertex order
+ *Meant to run offline, when a mesh is converted, since it costs far more than drawing the result does. GPUs keep a small cache of
+ *recently transformed vertices, so how often a vertex shader runs depends on the order triangles are drawn in; how many pixels
+ *are shaded and then covered up again depends on it too*/
+
+//Vertices in the cache that meshCacheStatistics simulates - a FIFO, like most hardware's
+#define MESH_CACHE_SIZE 16
+
+typedef struct {
+	float acmr;		//average cache miss ratio: vertex shader runs per triangle, 0.5 at best and 3 at worst
+	float atvr;		//average transformed vertex ratio: vertex shader runs per vertex used, 1 at best
+} mesh_cache_statistics;
+
+//Simulates a MESH_CACHE_SIZE FIFO cache drawing indices as a triangle list; every index has to be below vertex_count
+//Returns 0 if it runs out of memory
+int meshCacheStatistics(uint32_t const *indices, size_t index_count, size_t vertex_count, mesh_cache_statistics *statistics);
+
+/*Writes part's triangles to out as a triangle list (which needs room for 3 * part->count indices), skipping degenerate ones
+ *Strips keep their alternating winding. Returns the number of indices written - 0 for parts that aren't triangles*/
+size_t triangulatePart(uint32_t *out, mesh const *m, mesh_part const *part);
+
+//Reorders a triangle list's triangles for the vertex cache, using Tom Forsyth's "Linear-Speed Vertex Cache Optimisation"
+//Returns 0 (leaving indices untouched) if it runs out of memory
+int optimizeVertexCache(uint32_t *indices, size_t index_count, size_t vertex_count);
+
+/*Reorders the clusters optimizeVertexCache leaves behind (runs of triangles that start with a cold cache) so those facing away from
+ *the middle of the mesh are drawn first, as they're the likeliest to hide the others - Sander, Nehab and Barczak's "Fast
+ *Triangle Reordering for Vertex Locality and Reduced Overdraw", without its view-dependent part. Triangles keep their order
+ *within a cluster, so the cache hardly notices. positions holds components (at least 3) floats per vertex
+ *Returns 0 (leaving indices untouched) if it runs out of memory*/
+int optimizeOverdraw(uint32_t *indices, size_t index_count, float const *positions, unsigned int components, size_t vertex_count);
+
+/*A copy of m with every triangle part turned into one triangle list, optimised with optimizeVertexCache and optimizeOverdraw,
+ *followed by m's other parts. Vertices are renumbered in the order they're first used, so fetching them walks through memory
+ *in order too, and unused ones are dropped. before and after, when they aren't NULL, get the cache statistics of the triangles
+ *in m (as lists) and in the result. Returns NULL if it runs out of memory; the result is freed with closeMesh*/
+mesh *optimizeMesh(mesh const *m, mesh_cache_statistics *before, mesh_cache_statistics *after);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
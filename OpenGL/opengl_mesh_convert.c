@@ -0,0 +1,106 @@
+/*Converts Wavefront OBJ files to the binary mesh format opengl.c loads with --mesh
+ *
+ *Build:	gcc -O2 -o opengl_mesh_convert opengl_mesh_convert.c opengl_mesh.c -lm
+ *Run:		./opengl_mesh_convert [--no-optimize] input.obj output.mesh
+ *
+ *Unless --no-optimize is given, the triangles are reordered with optimizeMesh, and the vertex cache statistics before and after
+ *are reported (see mesh_cache_statistics)
+ *The output is read back with openMesh before exiting, so a file that converts is one the viewer can load*/
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include "opengl_mesh.h"
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <time.h>
+#endif
+
+static double nowSeconds(void) {
+#ifdef _WIN32
+	LARGE_INTEGER frequency, counter;
+	QueryPerformanceFrequency(&frequency);
+	QueryPerformanceCounter(&counter);
+
+	return (double) counter.QuadPart / (double) frequency.QuadPart;
+#else
+	struct timespec t;
+	clock_gettime(CLOCK_MONOTONIC, &t);
+
+	return (double) t.tv_sec + (double) t.tv_nsec * 1e-9;
+#endif
+}
+
+int main(int argc, char **argv) {
+	int optimize = !(argc == 4 && strcmp(argv[1], "--no-optimize") == 0);
+
+	if(argc != 3 && optimize) {
+		fprintf(stderr, "Usage: %s [--no-optimize] input.obj output.mesh\n", argv[0]);
+
+		return EXIT_FAILURE;
+	}
+
+	char const *input = argv[argc - 2];
+	char const *output = argv[argc - 1];
+
+	char const *error = NULL;
+
+	double start = nowSeconds();
+	mesh *m = loadObjMesh(input, &error);
+	double parsed = nowSeconds();
+
+	if(m == NULL) {
+		fprintf(stderr, "%s: %s\n", input, error);
+
+		return EXIT_FAILURE;
+	}
+
+	double optimized = parsed;
+
+	if(optimize) {
+		mesh_cache_statistics before, after;
+		mesh *optimized_mesh = optimizeMesh(m, &before, &after);
+		optimized = nowSeconds();
+
+		closeMesh(m);
+
+		if(optimized_mesh == NULL) {
+			fprintf(stderr, "%s: out of memory\n", input);
+
+			return EXIT_FAILURE;
+		}
+
+		m = optimized_mesh;
+
+		printf("vertex cache (%d entries): ACMR %.3f -> %.3f, ATVR %.3f -> %.3f\n", MESH_CACHE_SIZE, before.acmr, after.acmr, before.atvr, after.atvr);
+	}
+
+	if(!writeMesh(output, m)) {
+		fprintf(stderr, "%s: couldn't write the mesh\n", output);
+		closeMesh(m);
+
+		return EXIT_FAILURE;
+	}
+
+	closeMesh(m);
+
+	double written = nowSeconds();
+	m = openMesh(output, &error);
+	double opened = nowSeconds();
+
+	if(m == NULL) {
+		fprintf(stderr, "%s: %s\n", output, error);
+
+		return EXIT_FAILURE;
+	}
+
+	printf("%zu vertices, %zu indices (%zu bytes each), %zu streams, %zu parts\n", m->vertex_count, m->index_count, m->index_size, m->stream_count, m->part_count);
+	printf("bounds (%g, %g, %g) to (%g, %g, %g)\n", m->bounds_min[0], m->bounds_min[1], m->bounds_min[2], m->bounds_max[0], m->bounds_max[1], m->bounds_max[2]);
+	printf("OBJ parsed in %.3f ms, optimised in %.3f ms, mesh written in %.3f ms, mapped and checked in %.3f ms\n",
+		   (parsed - start)*1e3, (optimized - parsed)*1e3, (written - optimized)*1e3, (opened - written)*1e3);
+
+	closeMesh(m);
+
+	return EXIT_SUCCESS;
+}
@@ -0,0 +1,137 @@
+#include <stdlib.h>
+#include <string.h>
+#include "opengl_scene.h"
+
+//Resizes every per-node array; on failure, the graph is left as it was
+static int growSceneGraph(scene_graph *graph, size_t capacity) {
+	size_t *parent = realloc(graph->parent, capacity * sizeof(size_t));
+	if(parent == NULL) {
+		return 0;
+	}
+	graph->parent = parent;
+
+	mat4 *local = realloc(graph->local, capacity * sizeof(mat4));
+	if(local == NULL) {
+		return 0;
+	}
+	graph->local = local;
+
+	mat4 *world = realloc(graph->world, capacity * sizeof(mat4));
+	if(world == NULL) {
+		return 0;
+	}
+	graph->world = world;
+
+	unsigned char *dirty = realloc(graph->dirty, capacity);
+	if(dirty == NULL) {
+		return 0;
+	}
+	graph->dirty = dirty;
+
+	graph->capacity = capacity;
+
+	return 1;
+}
+
+scene_graph *createSceneGraph(size_t capacity) {
+	scene_graph *graph = calloc(1, sizeof(scene_graph));
+	if(graph == NULL) {
+		return NULL;
+	}
+
+	if(!growSceneGraph(graph, capacity > 0 ? capacity : 16)) {
+		destroySceneGraph(graph);
+
+		return NULL;
+	}
+
+	return graph;
+}
+
+void destroySceneGraph(scene_graph *graph) {
+	if(graph == NULL) {
+		return;
+	}
+
+	free(graph->parent);
+	free(graph->local);
+	free(graph->world);
+	free(graph->dirty);
+	free(graph);
+}
+
+size_t addSceneNode(scene_graph *graph, size_t parent, mat4 const *local) {
+	if(parent != SCENE_NO_PARENT && parent >= graph->count) {
+		return SCENE_NO_PARENT;
+	}
+
+	if(graph->count == graph->capacity && !growSceneGraph(graph, graph->capacity * 2)) {
+		return SCENE_NO_PARENT;
+	}
+
+	size_t node = graph->count++;
+
+	graph->parent[node] = parent;
+	graph->local[node] = *local;
+	//first_dirty needs no update: either something before the node is already dirty, or it was count, which is now the node
+	graph->dirty[node] = 1;
+
+	return node;
+}
+
+void setSceneNodeLocal(scene_graph *graph, size_t node, mat4 const *local) {
+	graph->local[node] = *local;
+	graph->dirty[node] = 1;
+
+	if(node < graph->first_dirty) {
+		graph->first_dirty = node;
+	}
+}
+
+mat4 const *sceneNodeWorld(scene_graph const *graph, size_t node) {
+	return graph->world + node;
+}
+
+size_t updateSceneGraph(scene_graph *graph) {
+	size_t const begin = graph->first_dirty;
+	size_t updated = 0;
+
+	graph->updated_begin = graph->count;
+	graph->updated_end = graph->count;
+
+	if(begin >= graph->count) {
+		return 0;
+	}
+
+	/*Nothing before first_dirty can change. From there on, a node is recomputed when it's dirty itself or its parent was
+	 *recomputed in this same pass - which, parents coming first, is already known by the time the node is reached
+	 *dirty doubles as "recomputed in this pass" until the end, when it's all cleared at once*/
+	size_t node;
+	for(node = begin; node < graph->count; ++node) {
+		size_t const parent = graph->parent[node];
+
+		if(parent != SCENE_NO_PARENT && parent >= begin && graph->dirty[parent]) {
+			graph->dirty[node] = 1;
+		}
+
+		if(graph->dirty[node]) {
+			if(parent == SCENE_NO_PARENT) {
+				graph->world[node] = graph->local[node];
+			} else {
+				multMat4(graph->world + node, graph->world + parent, graph->local + node);
+			}
+
+			if(updated == 0) {
+				graph->updated_begin = node;
+			}
+			graph->updated_end = node + 1;
+
+			++updated;
+		}
+	}
+
+	memset(graph->dirty + begin, 0, graph->count - begin);
+	graph->first_dirty = graph->count;
+
+	return updated;
+}
@@ -0,0 +1,59 @@
+#ifndef OPENGL_SCENE_H
+#define OPENGL_SCENE_H
+
+#include "opengl_math.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*Transform hierarchy
+ *Nodes are stored in flat arrays in the order they were added, and a node's parent must be added before it, so every parent comes
+ *before its children. That lets updateSceneGraph compute world matrices in a single forward pass, and since it only recomputes
+ *nodes whose local matrix changed (or one of whose ancestors' did), a frame where little moves costs little
+ *world is one contiguous array of mat4s, ready to be uploaded as per-instance data as it is*/
+
+//Parent of root nodes
+#define SCENE_NO_PARENT ((size_t) -1)
+
+typedef struct {
+	size_t count;
+	size_t capacity;
+
+	size_t *parent;			//SCENE_NO_PARENT or an index lower than the node's own
+	mat4 *local;			//relative to the parent
+	mat4 *world;			//parent's world * local, as of the last updateSceneGraph
+	unsigned char *dirty;	//local changed since the last updateSceneGraph
+
+	size_t first_dirty;		//count when nothing is dirty
+
+	//The world matrices rewritten by the last updateSceneGraph are all within [updated_begin, updated_end)
+	size_t updated_begin;
+	size_t updated_end;
+} scene_graph;
+
+//capacity is only a hint, the graph grows as needed
+//returns NULL on failure
+scene_graph *createSceneGraph(size_t capacity);
+
+void destroySceneGraph(scene_graph *graph);
+
+//parent is SCENE_NO_PARENT or a node already in the graph
+//returns the new node's index, or SCENE_NO_PARENT on failure
+size_t addSceneNode(scene_graph *graph, size_t parent, mat4 const *local);
+
+//Marks node, and so its whole subtree, for recomputation
+void setSceneNodeLocal(scene_graph *graph, size_t node, mat4 const *local);
+
+//Only up to date after updateSceneGraph
+mat4 const *sceneNodeWorld(scene_graph const *graph, size_t node);
+
+//Recomputes the world matrix of every dirty node and of all of their descendants
+//returns how many world matrices were recomputed
+size_t updateSceneGraph(scene_graph *graph);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif